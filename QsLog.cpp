@@ -25,6 +25,12 @@
 
 #include "QsLog.h"
 #include "QsLogDest.h"
+#include "QsLogContext.h"
+#include "QsLogForkLocks.h"
+#include "QsLogMetrics.h"
+#include "QsLogSharedLevels.h"
+#include "QsLogSignalSafe.h"
+#include "QsLogStackTrace.h"
 #ifdef QS_LOG_SEPARATE_THREAD
 #include <QThreadPool>
 #include <QRunnable>
@@ -32,9 +38,18 @@
 #include <QMutex>
 #include <QVector>
 #include <QDateTime>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QSharedMemory>
 #include <QtGlobal>
 #include <cstdlib>
+#include <limits>
+#include <new>
 #include <stdexcept>
+#if defined(Q_OS_UNIX)
+#include <pthread.h>
+#endif
 
 namespace QsLogging
 {
@@ -50,7 +65,70 @@ static const char FatalString[] = "FATAL";
 // not using Qt::ISODate because we need the milliseconds too
 static const QString fmtDateTime("yyyy-MM-ddThh:mm:ss.zzz");
 
-static Logger* sInstance = 0;
+// the writer refreshes destination buffer sizes whenever the queue drains, but trims at most this often
+static const qint64 TrimIntervalMs = 1000;
+
+// how long destroyInstance waits for queued messages to be written by default
+static const int DefaultShutdownTimeoutMs = 5000;
+
+// write latency bucket i counts writes of up to 2^i microseconds, the last one everything slower
+static const int WriteLatencyBuckets = 21;
+
+static int WriteLatencyBucket(qint64 ns)
+{
+    const qint64 us = ns / 1000;
+    int bucket = 0;
+    while (bucket < WriteLatencyBuckets - 1 && us > (Q_INT64_C(1) << bucket))
+        ++bucket;
+    return bucket;
+}
+
+// the logger that receives Qt's messages, see Logger::installQtMessageHandler
+static QAtomicPointer<Logger> sQtMessageTarget;
+static QtMessageHandler sPreviousQtMessageHandler = 0;
+
+// Set while a thread is writing to the destinations. A Qt message produced by a destination is
+// passed to the previous handler instead of being logged, which would recurse.
+static thread_local bool sWritingToDestinations = false;
+
+// the level set by the innermost ThreadLevelOverride of this thread, negative when there is none
+static thread_local int sThreadLevel = -1;
+
+static const LevelMask BuiltInLevels = (1u << OffLevel) - 1;
+static const LevelMask CustomLevels = ~((1u << FirstCustomLevel) - 1);
+
+// the built-in levels from 'level' up, i.e. what a linear threshold enables
+static LevelMask BuiltInLevelsFrom(int level)
+{
+    return BuiltInLevels & ~((1u << level) - 1);
+}
+
+// the threshold that corresponds to the built-in levels in 'levels'
+static Level LowestBuiltInLevel(LevelMask levels)
+{
+    for (int level = TraceLevel;level < OffLevel;++level) {
+        if (levels & (1u << level))
+            return static_cast<Level>(level);
+    }
+    return OffLevel;
+}
+
+static const int CustomLevelCount = LastCustomLevel - FirstCustomLevel + 1;
+
+// Names of the levels from Logger::registerLevel. A slot is written once, under the mutex, before
+// 'used' publishes it; readers don't lock.
+struct CustomLevelRegistry
+{
+    QMutex mutex;
+    QByteArray names[CustomLevelCount];
+    QAtomicInt used;
+};
+
+static CustomLevelRegistry& CustomLevelNames()
+{
+    static CustomLevelRegistry registry;
+    return registry;
+}
 
 static const char* LevelToText(Level theLevel)
 {
@@ -70,86 +148,815 @@ static const char* LevelToText(Level theLevel)
         case OffLevel:
             return "";
         default: {
+            CustomLevelRegistry& custom = CustomLevelNames();
+            const int index = theLevel - FirstCustomLevel;
+            if (index >= 0 && index < custom.used.loadAcquire())
+                return custom.names[index].constData();
             Q_ASSERT(!"bad log level");
             return InfoString;
         }
     }
 }
 
+class LoggerImpl;
+
 #ifdef QS_LOG_SEPARATE_THREAD
 class LogWriterRunnable : public QRunnable
 {
 public:
-    LogWriterRunnable(QString message, Level level);
+    LogWriterRunnable(LoggerImpl* logger, QString message, Level level, const StackFrames& stack,
+                      qint64 enqueuedAtMs, qint64 sizeInBytes);
+    ~LogWriterRunnable();
     virtual void run();
 
+    //! approximate memory held by a queued record
+    static qint64 recordSize(const QString& message, const StackFrames& stack);
+
 private:
+    LoggerImpl* mLogger;
     QString mMessage;
     Level mLevel;
+    StackFrames mStack;
+    qint64 mEnqueuedAtMs;
+    qint64 mSizeInBytes;
 };
 #endif
 
+// a record logged while the logger had no destination yet
+struct BootRecord
+{
+    BootRecord() : level(InfoLevel) {}
+    BootRecord(const QString& message_, Level level_) : message(message_), level(level_) {}
+    QString message;
+    Level level;
+};
+
+// What statistics() reads of a destination. The writer only adds to 'written' and the
+// destination's own counters are atomic, so they are read without logMutex.
+struct DestinationCounters
+{
+    explicit DestinationCounters(const DestinationPtr& destination_)
+        : destination(destination_), written(0) {}
+    DestinationPtr destination;
+    QAtomicInteger<qint64> written; // characters
+};
+typedef QSharedPointer<DestinationCounters> DestinationCountersPtr;
+
 class LoggerImpl
 {
 public:
     LoggerImpl();
+    ~LoggerImpl();
+
+    QString formatMessage(const QString& text, Level level) const;
+    void writeToDestinations(const QString& message, Level level);
+    void drainSignalRecords();
+    void keepBootRecord(const QString& message, Level level);
+    void replayBootRecords();
+    bool expireBootBuffer();
+    void closeBootBuffer();
+    LevelMask adoptSharedLevels();
+    void updateEffectiveLevel();
+    void updateLoadShedding(int queueDepth, qint64 lagMs, qint64 enqueuedAtMs);
+    bool writerStalled();
+    StackFrames captureStack(Level level) const;
+    QString appendStack(const QString& message, const StackFrames& stack);
+    void reportRecoveredStall();
+    bool reserveMemory(qint64 bytes, Level level);
+    void releaseMemory(qint64 bytes);
+    qint64 measureDestinationBuffers();
+    void trimBuffers();
+    void reinitializeAfterFork();
+    LoggerStatistics statistics();
+    void exportMetricsIfDue();
 
 #ifdef QS_LOG_SEPARATE_THREAD
-    QThreadPool threadPool;
+    void createThreadPool();
+
+    QThreadPool* threadPool;
+    QAtomicInt pendingCount;
 #endif
+    QAtomicInteger<qint64> memoryBudget;
+    QAtomicInt budgetKeepLevel;
+    QAtomicInteger<qint64> queuedBytes;
+    QAtomicInteger<qint64> destinationBytes;
+    QAtomicInteger<qint64> bootBytes;
+    QAtomicInteger<qint64> droppedRecords;
+    // writer watchdog: what the writer is busy with, -1 while it is idle, and the current stall
+    QAtomicInteger<qint64> writeStartedMs;
+    QAtomicInt currentDestination;
+    QAtomicInt watchdogStallMs;
+    DestinationPtr watchdogFallback;
+    QAtomicInteger<qint64> stallStartedMs;
+    QAtomicInt stalledDestination;
+    QAtomicInteger<qint64> stallDroppedRecords;
+    QAtomicInteger<qint64> writerStalls;
+    QAtomicInt stackTraceLevel;
+    StackSymbolizer symbolizer; // guarded by logMutex
+    qint64 lastTrimMs;
+    QAtomicInt shuttingDown;
+    int shutdownTimeoutMs;
+    bool writerStuck;
+    bool separateFilesAfterFork;
+    QElapsedTimer clock;
     QMutex logMutex;
     Level level;
+    LevelMask levelMask;
+    QAtomicInt effectiveLevel;
+    QAtomicInteger<LevelMask> effectiveLevels;
+    // where effectiveLevels is published for the logging macros: itself, or the shared page
+    QAtomicInteger<LevelMask>* publishedLevels;
+    LevelMask sharedLevelsWritten; // what the logger last wrote to the shared page
+    QSharedMemory* sharedLevels;
+    LoadSheddingOptions loadShedding;
+    int shedSteps;
+    qint64 queueEmptySinceMs; // when the writer last found the queue empty, -1 while it is not
     DestinationList destList;
+    // records kept until the first destination is added, guarded by logMutex
+    BootBufferOptions bootBuffer;
+    bool bootBuffering;
+    QVector<BootRecord> bootRecords;
+    qint64 bootDroppedRecords;
+    // Parallel to destList. Changed with both logMutex and countersMutex held; statistics() only
+    // takes countersMutex, which is never held while writing, so a stalled writer can't block it.
+    QVector<DestinationCountersPtr> destinationCounters;
+    QMutex countersMutex;
+    QAtomicInteger<qint64> levelRecords[LastCustomLevel + 1];
+    QAtomicInteger<qint64> writeLatency[WriteLatencyBuckets];
+    QAtomicInteger<qint64> writeLatencySumNs;
+    QMutex exportMutex;
+    MetricsExportOptions metricsExport; // guarded by exportMutex
+    QAtomicInteger<qint64> nextExportMs;
     bool includeTimeStamp;
     bool includeLogLevel;
 };
 
+// Every logger is tracked so that a fork() can't happen while one of them is in the middle of a
+// write, which would leave the child with a log mutex that can never be unlocked. The same goes
+// for the library's other mutexes, see QsLogForkLocks.h for the order they are taken in.
+// Function local statics, loggers may be created during static initialization.
+static QMutex& ForkRegistryMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+static QVector<LoggerImpl*>& ForkRegistry()
+{
+    static QVector<LoggerImpl*> loggers;
+    return loggers;
+}
+
+#if defined(Q_OS_UNIX)
+static void PrepareFork()
+{
+    ForkRegistryMutex().lock();
+    AdminSocketMutex().lock();
+    OutputCaptureMutex().lock();
+    const QVector<LoggerImpl*>& loggers = ForkRegistry();
+    for (int i = 0;i < loggers.size();++i) {
+        loggers.at(i)->exportMutex.lock();
+        loggers.at(i)->logMutex.lock();
+        loggers.at(i)->countersMutex.lock();
+    }
+    CustomLevelNames().mutex.lock();
+    SignalSafeMutex().lock();
+    CallSiteMutex().lock();
+}
+
+static void UnlockInnerForkMutexes()
+{
+    CallSiteMutex().unlock();
+    SignalSafeMutex().unlock();
+    CustomLevelNames().mutex.unlock();
+}
+
+static void UnlockOuterForkMutexes()
+{
+    OutputCaptureMutex().unlock();
+    AdminSocketMutex().unlock();
+    ForkRegistryMutex().unlock();
+}
+
+static void ParentAfterFork()
+{
+    UnlockInnerForkMutexes();
+    const QVector<LoggerImpl*>& loggers = ForkRegistry();
+    for (int i = loggers.size() - 1;i >= 0;--i) {
+        loggers.at(i)->countersMutex.unlock();
+        loggers.at(i)->logMutex.unlock();
+        loggers.at(i)->exportMutex.unlock();
+    }
+    UnlockOuterForkMutexes();
+}
+
+static void ChildAfterFork()
+{
+    UnlockInnerForkMutexes();
+    const QVector<LoggerImpl*>& loggers = ForkRegistry();
+    for (int i = loggers.size() - 1;i >= 0;--i) {
+        loggers.at(i)->countersMutex.unlock();
+        loggers.at(i)->reinitializeAfterFork();
+        loggers.at(i)->exportMutex.unlock();
+    }
+    OutputCaptureAfterFork();
+    AdminSocketAfterFork();
+    UnlockOuterForkMutexes();
+}
+#endif
+
+static void RegisterForFork(LoggerImpl* logger)
+{
+    QMutexLocker lock(&ForkRegistryMutex());
+#if defined(Q_OS_UNIX)
+    static bool handlersInstalled = false;
+    if (!handlersInstalled) {
+        pthread_atfork(&PrepareFork, &ParentAfterFork, &ChildAfterFork);
+        handlersInstalled = true;
+    }
+#endif
+    ForkRegistry().push_back(logger);
+}
+
+static void UnregisterForFork(LoggerImpl* logger)
+{
+    QMutexLocker lock(&ForkRegistryMutex());
+    const int index = ForkRegistry().indexOf(logger);
+    if (index >= 0)
+        ForkRegistry().remove(index);
+}
+
 #ifdef QS_LOG_SEPARATE_THREAD
-LogWriterRunnable::LogWriterRunnable(QString message, Level level)
+LogWriterRunnable::LogWriterRunnable(LoggerImpl* logger, QString message, Level level,
+                                     const StackFrames& stack, qint64 enqueuedAtMs,
+                                     qint64 sizeInBytes)
     : QRunnable()
+    , mLogger(logger)
     , mMessage(message)
     , mLevel(level)
+    , mStack(stack)
+    , mEnqueuedAtMs(enqueuedAtMs)
+    , mSizeInBytes(sizeInBytes)
+{
+}
+
+// A record that was never written, i.e. discarded by QThreadPool::clear() at shutdown, still has
+// its memory reserved.
+LogWriterRunnable::~LogWriterRunnable()
 {
+    if (mSizeInBytes)
+        mLogger->releaseMemory(mSizeInBytes);
+}
+
+qint64 LogWriterRunnable::recordSize(const QString& message, const StackFrames& stack)
+{
+    return sizeof(LogWriterRunnable) + message.capacity() * sizeof(QChar)
+        + stack.size() * sizeof(void*);
 }
 
 void LogWriterRunnable::run()
 {
-    Logger::instance().write(mMessage, mLevel);
+    LoggerImpl* d = mLogger;
+    const int queueDepth = d->pendingCount.fetchAndAddOrdered(-1) - 1;
+    const qint64 lagMs = d->clock.elapsed() - mEnqueuedAtMs;
+
+    {
+        QMutexLocker lock(&d->logMutex);
+        d->drainSignalRecords();
+        d->writeToDestinations(d->appendStack(mMessage, mStack), mLevel);
+        d->releaseMemory(mSizeInBytes);
+        mSizeInBytes = 0;
+        d->reportRecoveredStall();
+        d->updateLoadShedding(queueDepth, lagMs, mEnqueuedAtMs);
+        if (!queueDepth) {
+            d->destinationBytes.storeRelease(d->measureDestinationBuffers());
+            if (d->clock.elapsed() - d->lastTrimMs >= TrimIntervalMs)
+                d->trimBuffers();
+        }
+    }
+    d->exportMetricsIfDue();
 }
 #endif
 
 
 LoggerImpl::LoggerImpl()
-    : level(InfoLevel)
+    : memoryBudget(0)
+    , budgetKeepLevel(ErrorLevel)
+    , queuedBytes(0)
+    , destinationBytes(0)
+    , bootBytes(0)
+    , droppedRecords(0)
+    , writeStartedMs(-1)
+    , currentDestination(-1)
+    , watchdogStallMs(0)
+    , stallStartedMs(-1)
+    , stalledDestination(-1)
+    , stallDroppedRecords(0)
+    , writerStalls(0)
+    , stackTraceLevel(FatalLevel)
+    , lastTrimMs(0)
+    , shuttingDown(0)
+    , shutdownTimeoutMs(DefaultShutdownTimeoutMs)
+    , writerStuck(false)
+    , separateFilesAfterFork(false)
+    , level(InfoLevel)
+    , levelMask(BuiltInLevelsFrom(InfoLevel))
+    , effectiveLevel(InfoLevel)
+    , effectiveLevels(BuiltInLevelsFrom(InfoLevel))
+    , publishedLevels(&effectiveLevels)
+    , sharedLevelsWritten(0)
+    , sharedLevels(0)
+    , shedSteps(0)
+    , queueEmptySinceMs(-1)
+    , bootBuffering(true)
+    , bootDroppedRecords(0)
+    , writeLatencySumNs(0)
+    , nextExportMs(std::numeric_limits<qint64>::max())
     , includeTimeStamp(true)
     , includeLogLevel(true)
 {
     // assume at least file + console
     destList.reserve(2);
+    clock.start();
+#ifdef QS_LOG_SEPARATE_THREAD
+    createThreadPool();
+#endif
+    RegisterForFork(this);
+}
+
+LoggerImpl::~LoggerImpl()
+{
+    UnregisterForFork(this);
+#ifdef QS_LOG_SEPARATE_THREAD
+    delete threadPool;
+#endif
+    delete sharedLevels;
+}
+
+#ifdef QS_LOG_SEPARATE_THREAD
+void LoggerImpl::createThreadPool()
+{
+    threadPool = new QThreadPool;
+    threadPool->setMaxThreadCount(1);
+    threadPool->setExpiryTimeout(-1);
+}
+#endif
+
+// Runs in the child process, which only has the thread that called fork() and inherits the log
+// mutex locked by PrepareFork. The writer thread doesn't exist there, so the old pool is
+// abandoned (destroying it would wait for that thread) and the records it still holds are left to
+// the parent, which writes them.
+void LoggerImpl::reinitializeAfterFork()
+{
+#ifdef QS_LOG_SEPARATE_THREAD
+    createThreadPool();
+    pendingCount.storeRelease(0);
+    queuedBytes.storeRelease(0);
+#endif
+    shedSteps = 0;
+    updateEffectiveLevel();
+    for (DestinationList::iterator it = destList.begin(),
+        endIt = destList.end();it != endIt;++it) {
+        (*it)->afterFork(separateFilesAfterFork);
+    }
+    logMutex.unlock();
+}
+
+//! prepends the level, timestamp and the calling thread's diagnostic context to the text
+QString LoggerImpl::formatMessage(const QString& text, Level level) const
+{
+    QString completeMessage;
+    if (includeLogLevel) {
+        completeMessage.
+                append(LevelToText(level)).
+                append(' ');
+    }
+    if (includeTimeStamp) {
+        completeMessage.
+                append(QDateTime::currentDateTime().toString(fmtDateTime)).
+                append(' ');
+    }
+    completeMessage.append(DiagnosticContext::rendered());
+    completeMessage.append(text);
+    return completeMessage;
+}
+
+//! Writes the records logged from signal handlers since the last call, if they go through this
+//! logger. Must be called with logMutex held.
+void LoggerImpl::drainSignalRecords()
+{
+    if (SignalSafeLog::target() != this)
+        return;
+
+    SignalSafeRecord record;
+    while (SignalSafeLog::take(&record)) {
+        if (!(publishedLevels->loadAcquire() & levelBit(record.level)))
+            continue;
+        QString completeMessage;
+        if (includeLogLevel) {
+            completeMessage.
+                    append(LevelToText(record.level)).
+                    append(' ');
+        }
+        if (includeTimeStamp) {
+            completeMessage.
+                    append(QDateTime::fromMSecsSinceEpoch(record.timestampMs).toString(fmtDateTime)).
+                    append(' ');
+        }
+        completeMessage.append(QString::fromLatin1(record.message));
+        for (int i = 0;i < record.valueCount;++i)
+            completeMessage.append(' ').append(QString::number(record.values[i]));
+        writeToDestinations(completeMessage, record.level);
+    }
+}
+
+//! Sends the message to all the destinations. Must be called with logMutex held.
+void LoggerImpl::writeToDestinations(const QString& message, Level level)
+{
+    if (Q_UNLIKELY(destList.isEmpty())) {
+        if (bootBuffering)
+            keepBootRecord(message, level);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
 #ifdef QS_LOG_SEPARATE_THREAD
-    threadPool.setMaxThreadCount(1);
-    threadPool.setExpiryTimeout(-1);
+    writeStartedMs.storeRelease(clock.elapsed());
 #endif
+    sWritingToDestinations = true;
+    for (int i = 0;i < destList.size();++i) {
+        currentDestination.storeRelease(i);
+        destList.at(i)->write(message, level);
+        destinationCounters.at(i)->written.fetchAndAddRelaxed(message.size());
+    }
+    sWritingToDestinations = false;
+    currentDestination.storeRelease(-1);
+#ifdef QS_LOG_SEPARATE_THREAD
+    writeStartedMs.storeRelease(-1);
+#endif
+
+    const qint64 ns = timer.nsecsElapsed();
+    levelRecords[level].fetchAndAddRelaxed(1);
+    writeLatency[WriteLatencyBucket(ns)].fetchAndAddRelaxed(1);
+    writeLatencySumNs.fetchAndAddRelaxed(ns);
+}
+
+//! Must be called with logMutex held.
+void LoggerImpl::keepBootRecord(const QString& message, Level level)
+{
+    if (expireBootBuffer())
+        return;
+
+    const qint64 bytes = sizeof(BootRecord) + message.capacity() * sizeof(QChar);
+    const qint64 budget = memoryBudget.loadAcquire();
+    const bool fits = budget <= 0 || level >= budgetKeepLevel.loadAcquire()
+        || queuedBytes.loadAcquire() + destinationBytes.loadAcquire() + bootBytes.loadAcquire()
+           + bytes <= budget;
+    if (bootRecords.size() < bootBuffer.maxRecords && fits) {
+        bootRecords.push_back(BootRecord(message, level));
+        bootBytes.fetchAndAddOrdered(bytes);
+    } else {
+        ++bootDroppedRecords;
+        if (!fits)
+            droppedRecords.fetchAndAddRelaxed(1);
+    }
+}
+
+//! Writes the kept records to the destinations, now that there are some, and stops keeping
+//! records. Must be called with logMutex held.
+void LoggerImpl::replayBootRecords()
+{
+    if (expireBootBuffer())
+        return;
+    QVector<BootRecord> records;
+    records.swap(bootRecords);
+    const qint64 dropped = bootDroppedRecords;
+    closeBootBuffer();
+
+    for (int i = 0;i < records.size();++i)
+        writeToDestinations(records.at(i).message, records.at(i).level);
+    if (dropped) {
+        const QString notice = QString::fromLatin1(dropped == 1
+            ? "%1 message logged before the first destination was added was dropped"
+            : "%1 messages logged before the first destination was added were dropped").arg(dropped);
+        writeToDestinations(formatMessage(notice, WarnLevel), WarnLevel);
+    }
+}
+
+//! Discards the kept records once the boot buffer's time is up. Returns whether it did, or had
+//! already. Must be called with logMutex held.
+bool LoggerImpl::expireBootBuffer()
+{
+    if (bootBuffering && clock.elapsed() >= bootBuffer.timeoutMs)
+        closeBootBuffer();
+    return !bootBuffering;
+}
+
+//! Must be called with logMutex held.
+void LoggerImpl::closeBootBuffer()
+{
+    bootBuffering = false;
+    bootRecords.clear();
+    bootRecords.squeeze();
+    bootDroppedRecords = 0;
+    bootBytes.storeRelease(0);
+}
+
+LoggerStatistics LoggerImpl::statistics()
+{
+    LoggerStatistics statistics;
+    for (int level = TraceLevel;level <= LastCustomLevel;++level) {
+        if (level == OffLevel)
+            continue;
+        if (level >= FirstCustomLevel && level - FirstCustomLevel >= CustomLevelNames().used.loadAcquire())
+            break;
+        statistics.levelNames.append(QString::fromLatin1(LevelToText(static_cast<Level>(level))).trimmed());
+        statistics.records.append(levelRecords[level].loadAcquire());
+    }
+    countersMutex.lock();
+    const QVector<DestinationCountersPtr> counters = destinationCounters;
+    countersMutex.unlock();
+    for (int i = 0;i < counters.size();++i) {
+        Destination* destination = counters.at(i)->destination.data();
+        statistics.destinationBytes.append(counters.at(i)->written.loadAcquire());
+        statistics.destinationRotations.append(destination->rotationCount());
+        const DestinationHealth* health = destination->health();
+        statistics.destinationBreakerOpen.append(health && health->isTripped());
+        statistics.destinationBreakerTrips.append(health ? health->tripCount() : 0);
+        statistics.destinationSkippedRecords.append(health ? health->skippedCount() : 0);
+        statistics.destinationDroppedMessages.append(destination->droppedMessages());
+    }
+    statistics.droppedRecords = droppedRecords.loadAcquire();
+    writerStalled(); // detects a stall even if nobody logs
+    statistics.writerStalls = writerStalls.loadAcquire();
+    if (stallStartedMs.loadAcquire() >= 0)
+        statistics.stalledDestination = stalledDestination.loadAcquire();
+#ifdef QS_LOG_SEPARATE_THREAD
+    statistics.queueDepth = pendingCount.loadAcquire();
+#endif
+    for (int i = 0;i < WriteLatencyBuckets;++i)
+        statistics.writeLatencyBuckets.append(writeLatency[i].loadAcquire());
+    statistics.writeLatencySumNs = writeLatencySumNs.loadAcquire();
+    return statistics;
+}
+
+// Called after a write, without logMutex. A thread that finds another one exporting moves on.
+void LoggerImpl::exportMetricsIfDue()
+{
+    if (clock.elapsed() < nextExportMs.loadAcquire() || !exportMutex.tryLock())
+        return;
+    if (!metricsExport.filePath.isEmpty() && clock.elapsed() >= nextExportMs.loadAcquire()) {
+        nextExportMs.storeRelease(clock.elapsed() + qMax(metricsExport.intervalMs, 1));
+        OpenMetricsExport::writeFile(metricsExport.filePath, OpenMetricsExport::text(statistics()));
+    }
+    exportMutex.unlock();
+}
+
+//! Takes over into the configured levels what an external tool (tools/qslogctl) changed in the
+//! shared page since the logger last wrote it: the levels it enabled or disabled stay so until a
+//! level setter changes them again, whatever load shedding does meanwhile. Returns the page as
+//! read. Must be called with logMutex held.
+LevelMask LoggerImpl::adoptSharedLevels()
+{
+    if (publishedLevels == &effectiveLevels)
+        return 0;
+    const LevelMask page = publishedLevels->loadAcquire();
+    const LevelMask enabled = page & ~sharedLevelsWritten;
+    const LevelMask disabled = sharedLevelsWritten & ~page;
+    if (enabled | disabled) {
+        levelMask = ((levelMask | enabled) & ~disabled) & ~levelBit(OffLevel);
+        level = LowestBuiltInLevel(levelMask);
+        sharedLevelsWritten = page;
+    }
+    return page;
+}
+
+//! Publishes what the logging macros check: the configured level, raised by the number of load
+//! shedding steps but never above the shedding ceiling, and the set of levels that it leaves
+//! enabled. Custom levels are not shed. Changes an external tool made in the shared page are
+//! taken over first, so they are never overwritten.
+void LoggerImpl::updateEffectiveLevel()
+{
+    for (;;) {
+        const LevelMask page = adoptSharedLevels();
+        int effective = level;
+        if (shuttingDown.loadAcquire())
+            effective = OffLevel;
+        else if (shedSteps > 0 && level < loadShedding.maxLevel)
+            effective = qMin(level + shedSteps, static_cast<int>(loadShedding.maxLevel));
+        const LevelMask levels = shuttingDown.loadAcquire()
+            ? 0 : levelMask & (BuiltInLevelsFrom(effective) | CustomLevels);
+        effectiveLevel.storeRelease(effective);
+        effectiveLevels.storeRelease(levels);
+        if (publishedLevels == &effectiveLevels)
+            return;
+        // the tool may have changed the page since it was read, its change is taken over first
+        if (publishedLevels->testAndSetOrdered(page, levels)) {
+            sharedLevelsWritten = levels;
+            return;
+        }
+    }
+}
+
+// Runs on the writer thread with logMutex held, once per written record. Every change of the
+// effective level is reported to the destinations so that gaps in the log can be explained.
+void LoggerImpl::updateLoadShedding(int queueDepth, qint64 lagMs, qint64 enqueuedAtMs)
+{
+    // the record was the first one after the queue had drained, it tells how long it stayed empty
+    const qint64 idleMs = queueEmptySinceMs < 0 ? 0 : enqueuedAtMs - queueEmptySinceMs;
+    queueEmptySinceMs = queueDepth ? -1 : clock.elapsed();
+    if (!loadShedding.enabled && !shedSteps)
+        return;
+
+    const int maxSteps = loadShedding.enabled ? qMax(0, loadShedding.maxLevel - level) : 0;
+    const int nextStep = shedSteps + 1;
+    const bool queueHigh = loadShedding.queueHighWater > 0
+        && queueDepth >= loadShedding.queueHighWater * nextStep;
+    const bool lagHigh = loadShedding.lagHighWaterMs > 0
+        && lagMs >= loadShedding.lagHighWaterMs * qint64(nextStep);
+    const bool queueLow = loadShedding.queueHighWater <= 0
+        || queueDepth < loadShedding.queueLowWater * shedSteps;
+    const bool lagLow = loadShedding.lagHighWaterMs <= 0
+        || lagMs < loadShedding.lagLowWaterMs * qint64(shedSteps);
+
+    int steps = shedSteps;
+    if (loadShedding.idleRestoreMs > 0 && idleMs >= loadShedding.idleRestoreMs)
+        steps = 0;
+    else if (steps < maxSteps && (queueHigh || lagHigh))
+        ++steps;
+    else if (steps > 0 && queueLow && lagLow)
+        --steps;
+    steps = qMin(steps, maxSteps);
+    if (steps == shedSteps)
+        return;
+
+    const bool raised = steps > shedSteps;
+    shedSteps = steps;
+    updateEffectiveLevel();
+
+    const Level effective = static_cast<Level>(effectiveLevel.loadAcquire());
+    const QString notice = QString::fromLatin1("QsLog: load shedding %1 the minimum level to %2 "
+                                               "(queue depth: %3, writer lag: %4 ms)")
+        .arg(QLatin1String(raised ? "raised" : "lowered"))
+        .arg(QString::fromLatin1(LevelToText(effective)).trimmed())
+        .arg(queueDepth)
+        .arg(lagMs);
+    const Level noticeLevel = raised ? WarnLevel : InfoLevel;
+    writeToDestinations(formatMessage(notice, noticeLevel), noticeLevel);
+}
+
+// Called by producers. The writer counts as stalled once it has spent more than the watchdog's
+// stall time on one record; the producer that notices first records where it is stuck.
+bool LoggerImpl::writerStalled()
+{
+    const int stallMs = watchdogStallMs.loadAcquire();
+    if (stallMs <= 0)
+        return false;
+    const qint64 startedMs = writeStartedMs.loadAcquire();
+    if (startedMs < 0 || clock.elapsed() - startedMs < stallMs)
+        return false;
+
+    if (stallStartedMs.testAndSetOrdered(-1, startedMs)) {
+        stalledDestination.storeRelease(currentDestination.loadAcquire());
+        writerStalls.fetchAndAddRelaxed(1);
+    }
+    return true;
+}
+
+// Runs on the writer thread with logMutex held, once per written record. The first record
+// written after a stall reports it.
+void LoggerImpl::reportRecoveredStall()
+{
+    const qint64 startedMs = stallStartedMs.loadAcquire();
+    if (startedMs < 0)
+        return;
+
+    const QString notice = QString::fromLatin1("QsLog: the writer was stalled for %1 ms in "
+                                               "destination %2, %3 records below %4 were dropped")
+        .arg(clock.elapsed() - startedMs)
+        .arg(stalledDestination.loadAcquire())
+        .arg(stallDroppedRecords.fetchAndStoreOrdered(0))
+        .arg(QString::fromLatin1(LevelToText(static_cast<Level>(budgetKeepLevel.loadAcquire()))).trimmed());
+    stalledDestination.storeRelease(-1);
+    stallStartedMs.storeRelease(-1);
+
+    const QString message = formatMessage(notice, WarnLevel);
+    if (watchdogFallback.isNull())
+        writeToDestinations(message, WarnLevel);
+    else
+        watchdogFallback->write(message, WarnLevel);
+}
+
+// Runs on the logging thread, so only the raw addresses are taken. Custom levels never get a stack.
+StackFrames LoggerImpl::captureStack(Level level) const
+{
+    if (level > FatalLevel || level < stackTraceLevel.loadAcquire())
+        return StackFrames();
+    // leaves out this function and the one that called it on behalf of the logging statement
+    return StackTrace::capture(2);
+}
+
+// Runs on the writer thread with logMutex held, which guards the symbol cache.
+QString LoggerImpl::appendStack(const QString& message, const StackFrames& stack)
+{
+    if (stack.isEmpty())
+        return message;
+    return message + symbolizer.resolve(stack);
+}
+
+// Accounts for a record about to be queued. Returns false if it has to be dropped because the
+// memory budget is exhausted or the writer is stalled; records at or above the keep level are
+// always admitted.
+bool LoggerImpl::reserveMemory(qint64 bytes, Level level)
+{
+    const qint64 used = queuedBytes.fetchAndAddOrdered(bytes) + bytes;
+    const qint64 budget = memoryBudget.loadAcquire();
+    if (level >= budgetKeepLevel.loadAcquire())
+        return true;
+    const bool stalled = writerStalled();
+    if (!stalled && (budget <= 0
+                     || used + destinationBytes.loadAcquire() + bootBytes.loadAcquire() <= budget))
+        return true;
+
+    queuedBytes.fetchAndAddOrdered(-bytes);
+    droppedRecords.fetchAndAddRelaxed(1);
+    if (stalled)
+        stallDroppedRecords.fetchAndAddRelaxed(1);
+    return false;
+}
+
+void LoggerImpl::releaseMemory(qint64 bytes)
+{
+    queuedBytes.fetchAndAddOrdered(-bytes);
+}
+
+//! Must be called with logMutex held.
+qint64 LoggerImpl::measureDestinationBuffers()
+{
+    qint64 total = 0;
+    for (DestinationList::iterator it = destList.begin(),
+        endIt = destList.end();it != endIt;++it) {
+        total += (*it)->bufferedBytes();
+    }
+    return total;
+}
+
+//! Must be called with logMutex held.
+void LoggerImpl::trimBuffers()
+{
+    for (DestinationList::iterator it = destList.begin(),
+        endIt = destList.end();it != endIt;++it) {
+        (*it)->trimBuffers();
+    }
+    destinationBytes.storeRelease(measureDestinationBuffers());
+    lastTrimMs = clock.elapsed();
 }
 
 
+Logger* Logger::sInstance = 0;
+bool Logger::sOwnsInstance = false;
+QAtomicInt Logger::sThreadLevelOverrides(0);
+
 Logger::Logger()
     : d(new LoggerImpl)
+    , effectiveLevels(&d->effectiveLevels)
 {
 }
 
-Logger& Logger::instance()
+// the slow path of instance(), kept out of line
+Logger& Logger::createInstance()
 {
-    if (!sInstance)
+    if (!sInstance) {
         sInstance = new Logger;
+        sOwnsInstance = true;
+    }
 
     return *sInstance;
 }
 
-void Logger::destroyInstance()
+int Logger::destroyInstance()
 {
-    delete sInstance;
+    if (!sInstance)
+        return 0;
+
+    int discarded = 0;
+    if (sOwnsInstance) {
+        discarded = sInstance->shutdown(sInstance->shutdownTimeout());
+        delete sInstance;
+    }
     sInstance = 0;
+    sOwnsInstance = false;
+    return discarded;
+}
+
+void Logger::bindInstance(Logger* host)
+{
+    if (host == sInstance)
+        return;
+
+    destroyInstance();
+    sInstance = host;
 }
 
 // tries to extract the level from a string log message. If available, conversionSucceeded will
@@ -171,6 +978,11 @@ Level Logger::levelFromLogMessage(const QString& logMessage, bool* conversionSuc
         return ErrorLevel;
     if (logMessage.startsWith(QLatin1String(FatalString)))
         return FatalLevel;
+    CustomLevelRegistry& custom = CustomLevelNames();
+    for (int i = 0, used = custom.used.loadAcquire();i < used;++i) {
+        if (logMessage.startsWith(QLatin1String(custom.names[i])))
+            return static_cast<Level>(FirstCustomLevel + i);
+    }
 
     if (conversionSucceeded)
         *conversionSucceeded = false;
@@ -179,29 +991,429 @@ Level Logger::levelFromLogMessage(const QString& logMessage, bool* conversionSuc
 
 Logger::~Logger()
 {
+    removeQtMessageHandler();
+    shutdown(d->shutdownTimeoutMs);
+    // a writer that is still blocked in a destination keeps using d, see shutdown()
+    if (!d->writerStuck)
+        delete d;
+    else
+        UnregisterForFork(d);
+    d = 0;
+}
+
+// The shutdown sequence: the effective level is set to OffLevel so the logging macros stop
+// producing records at no extra cost, the queue is drained until the deadline and whatever is
+// left is discarded. Finally the destinations are flushed and released in the order they were
+// added. If the writer is still blocked inside a destination when the deadline expires, the
+// destinations are left alone and the logger's internals are leaked rather than freed under it.
+int Logger::shutdown(int drainTimeoutMs)
+{
+    if (d->shuttingDown.fetchAndStoreOrdered(1))
+        return 0;
+    {
+        QMutexLocker lock(&d->logMutex);
+        // before the levels drop to nothing
+        d->drainSignalRecords();
+        SignalSafeLog::detach(d);
+        d->closeBootBuffer();
+        d->updateEffectiveLevel();
+    }
+
+    int discarded = 0;
 #ifdef QS_LOG_SEPARATE_THREAD
-    d->threadPool.waitForDone();
+    if (!d->threadPool->waitForDone(drainTimeoutMs)) {
+        d->threadPool->clear();
+        discarded = d->pendingCount.fetchAndStoreOrdered(0);
+        d->writerStuck = !d->threadPool->waitForDone(0);
+    }
+#else
+    Q_UNUSED(drainTimeoutMs);
 #endif
-    delete d;
-    d = 0;
+
+    if (!d->writerStuck) {
+        QMutexLocker lock(&d->logMutex);
+        for (DestinationList::iterator it = d->destList.begin(),
+            endIt = d->destList.end();it != endIt;++it) {
+            (*it)->flush();
+            it->clear();
+        }
+        d->destList.clear();
+        QMutexLocker countersLock(&d->countersMutex);
+        d->destinationCounters.clear();
+    }
+    return discarded;
+}
+
+void Logger::setSeparateFilesAfterFork(bool enabled)
+{
+    QMutexLocker lock(&d->logMutex);
+    d->separateFilesAfterFork = enabled;
+}
+
+bool Logger::separateFilesAfterFork() const
+{
+    QMutexLocker lock(&d->logMutex);
+    return d->separateFilesAfterFork;
+}
+
+void Logger::setShutdownTimeout(int drainTimeoutMs)
+{
+    d->shutdownTimeoutMs = drainTimeoutMs;
+}
+
+int Logger::shutdownTimeout() const
+{
+    return d->shutdownTimeoutMs;
 }
 
 void Logger::addDestination(DestinationPtr destination)
 {
     Q_ASSERT(destination.data());
+    QMutexLocker lock(&d->logMutex);
     d->destList.push_back(destination);
+    {
+        QMutexLocker countersLock(&d->countersMutex);
+        d->destinationCounters.push_back(DestinationCountersPtr(new DestinationCounters(destination)));
+    }
+    d->replayBootRecords();
+}
+
+void Logger::setBootBuffer(const BootBufferOptions& options)
+{
+    Q_ASSERT(options.maxRecords >= 0);
+    QMutexLocker lock(&d->logMutex);
+    d->bootBuffer = options;
+    if (!d->bootBuffering)
+        return;
+    if (!options.maxRecords) {
+        d->closeBootBuffer();
+    } else if (d->bootRecords.size() > options.maxRecords) {
+        d->bootDroppedRecords += d->bootRecords.size() - options.maxRecords;
+        d->bootRecords.resize(options.maxRecords);
+    }
+}
+
+BootBufferOptions Logger::bootBuffer() const
+{
+    QMutexLocker lock(&d->logMutex);
+    return d->bootBuffer;
 }
 
 void Logger::setLoggingLevel(Level newLevel)
 {
+    Q_ASSERT(newLevel <= OffLevel);
+    QMutexLocker lock(&d->logMutex);
+    d->adoptSharedLevels();
     d->level = newLevel;
+    d->levelMask = (d->levelMask & CustomLevels) | BuiltInLevelsFrom(newLevel);
+    d->updateEffectiveLevel();
 }
 
 Level Logger::loggingLevel() const
 {
+    QMutexLocker lock(&d->logMutex);
+    d->adoptSharedLevels();
     return d->level;
 }
 
+Level Logger::effectiveLoggingLevel() const
+{
+    return static_cast<Level>(d->effectiveLevel.loadAcquire());
+}
+
+Level Logger::registerLevel(const QString& name)
+{
+    CustomLevelRegistry& custom = CustomLevelNames();
+    QMutexLocker lock(&custom.mutex);
+    // padded like the built-in names, so messages line up
+    const QByteArray text = name.toLatin1().leftJustified(sizeof(InfoString) - 1, ' ');
+    const int used = custom.used.loadAcquire();
+    for (int i = 0;i < used;++i) {
+        if (custom.names[i] == text)
+            return static_cast<Level>(FirstCustomLevel + i);
+    }
+    if (used == CustomLevelCount)
+        return OffLevel;
+
+    custom.names[used] = text;
+    custom.used.storeRelease(used + 1);
+    return static_cast<Level>(FirstCustomLevel + used);
+}
+
+void Logger::setLevelEnabled(Level level, bool enabled)
+{
+    Q_ASSERT(level != OffLevel);
+    QMutexLocker lock(&d->logMutex);
+    d->adoptSharedLevels();
+    if (enabled)
+        d->levelMask |= levelBit(level);
+    else
+        d->levelMask &= ~levelBit(level);
+    d->level = LowestBuiltInLevel(d->levelMask);
+    d->updateEffectiveLevel();
+}
+
+void Logger::setEnabledLevels(LevelMask levels)
+{
+    QMutexLocker lock(&d->logMutex);
+    d->adoptSharedLevels();
+    d->levelMask = levels & ~levelBit(OffLevel);
+    d->level = LowestBuiltInLevel(d->levelMask);
+    d->updateEffectiveLevel();
+}
+
+LevelMask Logger::enabledLevels() const
+{
+    QMutexLocker lock(&d->logMutex);
+    d->adoptSharedLevels();
+    return d->levelMask;
+}
+
+bool Logger::shareLevels(const QString& key)
+{
+    QMutexLocker lock(&d->logMutex);
+    if (d->sharedLevels)
+        return false;
+
+    QScopedPointer<QSharedMemory> memory(new QSharedMemory(key));
+    if (!memory->create(sizeof(SharedLevelPage))) {
+        // on Unix the segment of a process that crashed outlives it; it is taken over
+        if (memory->error() != QSharedMemory::AlreadyExists || !memory->attach()
+            || memory->size() < static_cast<int>(sizeof(SharedLevelPage)))
+            return false;
+    }
+    SharedLevelPage* page = new (memory->data()) SharedLevelPage;
+    page->levels.storeRelease(d->effectiveLevels.loadAcquire());
+    d->sharedLevelsWritten = d->effectiveLevels.loadAcquire();
+    d->publishedLevels = &page->levels;
+    d->sharedLevels = memory.take();
+    effectiveLevels = d->publishedLevels;
+    return true;
+}
+
+void Logger::setLoadShedding(const LoadSheddingOptions& options)
+{
+    QMutexLocker lock(&d->logMutex);
+    d->loadShedding = options;
+    if (!options.enabled)
+        d->shedSteps = 0;
+    d->updateEffectiveLevel();
+}
+
+LoadSheddingOptions Logger::loadShedding() const
+{
+    QMutexLocker lock(&d->logMutex);
+    return d->loadShedding;
+}
+
+void Logger::setWriterWatchdog(const WriterWatchdogOptions& options)
+{
+    QMutexLocker lock(&d->logMutex);
+    d->watchdogFallback = options.fallback;
+    d->watchdogStallMs.storeRelease(options.stallMs);
+}
+
+WriterWatchdogOptions Logger::writerWatchdog() const
+{
+    QMutexLocker lock(&d->logMutex);
+    WriterWatchdogOptions options;
+    options.stallMs = d->watchdogStallMs.loadAcquire();
+    options.fallback = d->watchdogFallback;
+    return options;
+}
+
+void Logger::setStackTraceLevel(Level level)
+{
+    d->stackTraceLevel.storeRelease(level);
+}
+
+Level Logger::stackTraceLevel() const
+{
+    return static_cast<Level>(d->stackTraceLevel.loadAcquire());
+}
+
+void Logger::setMemoryBudget(const MemoryBudget& budget)
+{
+    Q_ASSERT(budget.bytes >= 0);
+    d->budgetKeepLevel.storeRelease(budget.keepLevel);
+    d->memoryBudget.storeRelease(budget.bytes);
+}
+
+MemoryBudget Logger::memoryBudget() const
+{
+    return MemoryBudget(d->memoryBudget.loadAcquire(),
+                        static_cast<Level>(d->budgetKeepLevel.loadAcquire()));
+}
+
+MemoryUsage Logger::memoryUsage() const
+{
+    MemoryUsage usage;
+    {
+        QMutexLocker lock(&d->logMutex);
+        d->destinationBytes.storeRelease(d->measureDestinationBuffers());
+    }
+    usage.budgetBytes = d->memoryBudget.loadAcquire();
+    usage.queuedBytes = d->queuedBytes.loadAcquire();
+    usage.destinationBytes = d->destinationBytes.loadAcquire();
+    usage.bootBytes = d->bootBytes.loadAcquire();
+    usage.droppedRecords = d->droppedRecords.loadAcquire();
+    return usage;
+}
+
+LoggerStatistics Logger::statistics() const
+{
+    return d->statistics();
+}
+
+void Logger::setMetricsExport(const MetricsExportOptions& options)
+{
+    QMutexLocker lock(&d->exportMutex);
+    d->metricsExport = options;
+    d->nextExportMs.storeRelease(options.filePath.isEmpty()
+        ? std::numeric_limits<qint64>::max() : d->clock.elapsed());
+}
+
+MetricsExportOptions Logger::metricsExport() const
+{
+    QMutexLocker lock(&d->exportMutex);
+    return d->metricsExport;
+}
+
+void Logger::trimMemory()
+{
+    QMutexLocker lock(&d->logMutex);
+    d->trimBuffers();
+}
+
+void Logger::flush()
+{
+    QMutexLocker lock(&d->logMutex);
+    d->drainSignalRecords();
+    d->expireBootBuffer();
+    for (DestinationList::iterator it = d->destList.begin(),
+        endIt = d->destList.end();it != endIt;++it) {
+        (*it)->flush();
+    }
+}
+
+void Logger::installQtMessageHandler()
+{
+    Logger* previousTarget = sQtMessageTarget.fetchAndStoreOrdered(this);
+    if (!previousTarget)
+        sPreviousQtMessageHandler = qInstallMessageHandler(&Logger::handleQtMessage);
+}
+
+void Logger::removeQtMessageHandler()
+{
+    if (sQtMessageTarget.testAndSetOrdered(this, 0))
+        qInstallMessageHandler(sPreviousQtMessageHandler);
+}
+
+static Level LevelFromQtMsgType(QtMsgType type)
+{
+    switch (type) {
+        case QtDebugMsg:
+            return DebugLevel;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+        case QtInfoMsg:
+            return InfoLevel;
+#endif
+        case QtWarningMsg:
+            return WarnLevel;
+        case QtCriticalMsg:
+            return ErrorLevel;
+        case QtFatalMsg:
+            return FatalLevel;
+        default:
+            return WarnLevel;
+    }
+}
+
+// Called by Qt on the thread that produced the message. The record takes the same route as one
+// from the logging macros, so it is queued for the writer thread when there is one.
+void Logger::handleQtMessage(QtMsgType type, const QMessageLogContext& context,
+                             const QString& message)
+{
+    Logger* logger = sQtMessageTarget.loadAcquire();
+    if (!logger || sWritingToDestinations) {
+        if (sPreviousQtMessageHandler)
+            sPreviousQtMessageHandler(type, context, message);
+        return;
+    }
+
+    const Level level = LevelFromQtMsgType(type);
+    if (logger->isEnabled(level)) {
+        QString text;
+        if (context.file) {
+            text.append(QString::fromLocal8Bit(context.file)).append('@')
+                .append(QString::number(context.line)).append(' ');
+        }
+        if (context.function)
+            text.append(QString::fromLatin1(context.function)).append(' ');
+        if (context.category && qstrcmp(context.category, "default") != 0)
+            text.append(QString::fromLatin1(context.category)).append(QLatin1String(": "));
+        text.append(message);
+        logger->enqueueWrite(logger->d->formatMessage(text, level), level,
+                             logger->d->captureStack(level));
+    }
+
+    // Qt aborts as soon as this returns
+    if (type == QtFatalMsg)
+        logger->shutdown(logger->shutdownTimeout());
+}
+
+// the slow path of isEnabled, taken while some thread has a level override
+bool Logger::isEnabledWithOverride(Level level) const
+{
+    const int threadLevel = sThreadLevel;
+    const LevelMask levels = effectiveLevels->loadAcquire();
+    if (threadLevel < 0 || d->shuttingDown.loadAcquire())
+        return (levels & levelBit(level)) != 0;
+    return ((BuiltInLevelsFrom(threadLevel) | (levels & CustomLevels)) & levelBit(level)) != 0;
+}
+
+ThreadLevelOverride::ThreadLevelOverride(Level level)
+{
+    install(level);
+}
+
+ThreadLevelOverride::ThreadLevelOverride(int level)
+{
+    install(level);
+}
+
+// mPrevious is NotInstalled when "no override" was inherited by a thread without one, which
+// leaves the fast path of the logging macros untouched
+static const int NotInstalled = -2;
+
+void ThreadLevelOverride::install(int level)
+{
+    mPrevious = sThreadLevel;
+    if (level < 0 && mPrevious < 0) {
+        mPrevious = NotInstalled;
+        return;
+    }
+    sThreadLevel = level < 0 ? -1 : level;
+    Logger::sThreadLevelOverrides.fetchAndAddOrdered(1);
+}
+
+ThreadLevelOverride::~ThreadLevelOverride()
+{
+    if (mPrevious == NotInstalled)
+        return;
+    sThreadLevel = mPrevious;
+    Logger::sThreadLevelOverrides.fetchAndAddOrdered(-1);
+}
+
+bool ThreadLevelOverride::current(Level* level)
+{
+    if (sThreadLevel < 0)
+        return false;
+    if (level)
+        *level = static_cast<Level>(sThreadLevel);
+    return true;
+}
+
 void Logger::setIncludeTimestamp(bool e)
 {
     d->includeTimeStamp = e;
@@ -222,24 +1434,28 @@ bool Logger::includeLogLevel() const
     return d->includeLogLevel;
 }
 
+void Logger::logText(Level level, const QString& text)
+{
+    if (!isEnabled(level))
+        return;
+    enqueueWrite(d->formatMessage(text, level), level);
+}
+
 //! creates the complete log message and passes it to the logger
 void Logger::Helper::writeToLog()
 {
-    const char* const levelName = LevelToText(level);
-    QString completeMessage;
-    Logger &logger = Logger::instance();
-    if (logger.includeLogLevel()) {
-        completeMessage.
-                append(levelName).
-                append(' ');
-    }
-    if (logger.includeTimestamp()) {
-        completeMessage.
-                append(QDateTime::currentDateTime().toString(fmtDateTime)).
-                append(' ');
+    if (site && site->state() == CallSite::Measured) {
+        if (hasMeasuredValue)
+            site->measure(measuredValue);
+        else
+            site->measure(buffer);
+        return;
     }
-    completeMessage.append(buffer);
-    Logger::instance().enqueueWrite(completeMessage, level);
+
+    const QString message = logger.d->formatMessage(buffer, level);
+    if (site)
+        site->countRecord(message.size());
+    logger.enqueueWrite(message, level, logger.d->captureStack(level));
 }
 
 Logger::Helper::~Helper()
@@ -254,25 +1470,36 @@ Logger::Helper::~Helper()
 }
 
 //! directs the message to the task queue or writes it directly
-void Logger::enqueueWrite(const QString& message, Level level)
+void Logger::enqueueWrite(const QString& message, Level level, const StackFrames& stack)
 {
+    // catches the records that passed the level check just before shutdown started
+    if (d->shuttingDown.loadAcquire())
+        return;
+
 #ifdef QS_LOG_SEPARATE_THREAD
-    LogWriterRunnable *r = new LogWriterRunnable(message, level);
-    d->threadPool.start(r);
+    const qint64 sizeInBytes = LogWriterRunnable::recordSize(message, stack);
+    if (!d->reserveMemory(sizeInBytes, level))
+        return;
+
+    d->pendingCount.fetchAndAddOrdered(1);
+    LogWriterRunnable *r = new LogWriterRunnable(d, message, level, stack, d->clock.elapsed(),
+                                                 sizeInBytes);
+    d->threadPool->start(r);
 #else
-    write(message, level);
+    write(message, level, stack);
 #endif
 }
 
 //! Sends the message to all the destinations. The level for this message is passed in case
 //! it's useful for processing in the destination.
-void Logger::write(const QString& message, Level level)
+void Logger::write(const QString& message, Level level, const StackFrames& stack)
 {
-    QMutexLocker lock(&d->logMutex);
-    for (DestinationList::iterator it = d->destList.begin(),
-        endIt = d->destList.end();it != endIt;++it) {
-        (*it)->write(message, level);
+    {
+        QMutexLocker lock(&d->logMutex);
+        d->drainSignalRecords();
+        d->writeToDestinations(d->appendStack(message, stack), level);
     }
+    d->exportMetricsIfDue();
 }
 
 } // end namespace
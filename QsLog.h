@@ -28,8 +28,13 @@
 
 #include "QsLogLevel.h"
 #include "QsLogDest.h"
+#include "QsLogCallSite.h"
+#include "QsLogStackTrace.h"
 #include <QDebug>
 #include <QString>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QVector>
 
 #define QS_LOG_VERSION "2.0b3"
 
@@ -38,21 +43,275 @@ namespace QsLogging
 class Destination;
 class LoggerImpl; // d pointer
 
+//! Thresholds for the adaptive load shedding controller. When the number of queued records or the
+//! time a record waits before being written crosses a high water mark, the effective logging level
+//! is raised by one step. Each further step needs the backlog to grow past a multiple of the mark
+//! (2x, 3x...). A step is restored once both values drop below the low water mark multiplied by
+//! the current step count. All of them are restored by the first record logged after the queue
+//! stayed empty for 'idleRestoreMs'; that record has to be logged at the raised level. A value
+//! <= 0 disables the corresponding criterion.
+//! Only has an effect when QS_LOG_SEPARATE_THREAD is defined.
+struct QSLOG_SHARED_OBJECT LoadSheddingOptions
+{
+    LoadSheddingOptions()
+        : enabled(false)
+        , queueHighWater(10000)
+        , queueLowWater(1000)
+        , lagHighWaterMs(1000)
+        , lagLowWaterMs(100)
+        , maxLevel(WarnLevel)
+        , idleRestoreMs(1000)
+    {}
+
+    bool enabled;
+    int queueHighWater;
+    int queueLowWater;
+    int lagHighWaterMs;
+    int lagLowWaterMs;
+    //! Shedding never raises the effective level above this one, so e.g. errors are always kept.
+    Level maxLevel;
+    int idleRestoreMs;
+};
+
+//! Caps the memory held by the logger: records waiting for the writer thread plus whatever the
+//! destinations report as buffered. A record that does not fit is dropped and counted, unless its
+//! level is at least 'keepLevel'. A budget of 0 bytes means unlimited.
+struct QSLOG_SHARED_OBJECT MemoryBudget
+{
+    MemoryBudget() : bytes(0), keepLevel(ErrorLevel) {}
+    explicit MemoryBudget(qint64 bytes_, Level keepLevel_ = ErrorLevel)
+        : bytes(bytes_), keepLevel(keepLevel_) {}
+    qint64 bytes;
+    Level keepLevel;
+};
+
+struct QSLOG_SHARED_OBJECT MemoryUsage
+{
+    MemoryUsage() : budgetBytes(0), queuedBytes(0), destinationBytes(0), bootBytes(0), droppedRecords(0) {}
+    qint64 budgetBytes;
+    qint64 queuedBytes;      //!< records waiting for the writer thread
+    qint64 destinationBytes; //!< sum of Destination::bufferedBytes()
+    qint64 bootBytes;        //!< records kept until the first destination is added
+    qint64 droppedRecords;   //!< records discarded because the budget was exhausted
+};
+
+//! Counters kept by the logger since it was created, see Logger::statistics.
+struct QSLOG_SHARED_OBJECT LoggerStatistics
+{
+    LoggerStatistics()
+        : droppedRecords(0), queueDepth(0), writeLatencySumNs(0), writerStalls(0)
+        , stalledDestination(-1) {}
+    QStringList levelNames;            //!< the built-in and registered levels
+    QVector<qint64> records;           //!< records written, parallel to levelNames
+    QVector<qint64> destinationBytes;  //!< characters written, per destination in the order added
+    QVector<qint64> destinationRotations; //!< file rotations, per destination
+    //! Circuit breaker state per destination (see DestinationHealth), false/0 for destinations
+    //! without a breaker.
+    QVector<bool> destinationBreakerOpen;
+    QVector<qint64> destinationBreakerTrips;
+    QVector<qint64> destinationSkippedRecords; //!< records a tripped breaker kept away
+    QVector<qint64> destinationDroppedMessages; //!< messages a rate limiter dropped
+    //! Records discarded by the memory budget or a stall, before reaching any destination. The
+    //! drops and skips of single destinations are counted per destination above.
+    qint64 droppedRecords;
+    int queueDepth;                    //!< records waiting for the writer thread
+    //! Time taken to write one record to all destinations. Bucket i counts the writes that took
+    //! up to 2^i microseconds, the last one the slower writes.
+    QVector<qint64> writeLatencyBuckets;
+    qint64 writeLatencySumNs;
+    qint64 writerStalls;               //!< stalls detected by the writer watchdog
+    //! The destination the writer is stuck in, -1 if it isn't stalled.
+    int stalledDestination;
+};
+
+//! Watches the writer thread. Once it has spent more than 'stallMs' on one record, e.g. because
+//! a destination hangs on NFS or a full pipe, the writer counts as stalled: the destination it is
+//! stuck in is recorded (see LoggerStatistics) and producers apply the memory budget's overflow
+//! policy, dropping records below MemoryBudget::keepLevel, until the writer makes progress. When
+//! it does, a warning about the stall is written to 'fallback', or to the destinations if there
+//! is none. A stallMs <= 0 disables the watchdog, which is the default.
+//! Only has an effect when QS_LOG_SEPARATE_THREAD is defined.
+struct QSLOG_SHARED_OBJECT WriterWatchdogOptions
+{
+    WriterWatchdogOptions() : stallMs(0) {}
+    int stallMs;
+    DestinationPtr fallback;
+};
+
+//! Keeps the records logged before the first destination is added, e.g. from static initializers
+//! or plugin constructors, and writes them to that destination in order when it is added. At most
+//! 'maxRecords' are kept; the ones after that are dropped and counted in a warning written after
+//! the replay, as are the ones that don't fit in the memory budget. Once 'timeoutMs' have passed since the logger was created, the kept records are
+//! discarded and nothing more is kept; this is checked whenever a record is logged, a destination
+//! is added or the logger is flushed. On by default, but nothing is allocated until a record is
+//! logged without a destination, and once a destination exists this costs nothing. A maxRecords
+//! of 0 disables it.
+struct QSLOG_SHARED_OBJECT BootBufferOptions
+{
+    BootBufferOptions() : maxRecords(1000), timeoutMs(30000) {}
+    int maxRecords;
+    int timeoutMs;
+};
+
+//! Periodically writes Logger::statistics() and the log-derived metrics (see
+//! CallSiteRegistry::metrics) to a file in OpenMetrics text format, for a textfile collector.
+//! The file is replaced atomically by whichever thread writes the logs, at most once per
+//! interval and only while something is logged. An empty path disables the export.
+struct QSLOG_SHARED_OBJECT MetricsExportOptions
+{
+    MetricsExportOptions() : intervalMs(15000) {}
+    QString filePath;
+    int intervalMs;
+};
+
+//! instance() is the process wide logger used by the QLOG_* macros. Further loggers can be
+//! created directly, each with its own destinations, level and writer thread, and are targeted
+//! with the QLOG_*_TO(logger) macros.
 class QSLOG_SHARED_OBJECT Logger
 {
 public:
-    static Logger& instance();
-    static void destroyInstance();
+    Logger();
+    static Logger& instance()
+    {
+        return sInstance ? *sInstance : createInstance();
+    }
+    //! Shuts the logger down (see shutdown) using shutdownTimeout() and destroys it.
+    //! Returns the number of queued messages that were discarded. If instance() is bound to
+    //! another logger (see bindInstance) the binding is removed and nothing is destroyed.
+    static int destroyInstance();
+    //! Makes instance() in this module return 'host'. A plugin or library that links QsLog
+    //! statically has its own instance(); the host passes &Logger::instance() to it at load
+    //! time (e.g. through an exported init function) and the plugin binds to it, so that all
+    //! modules share one pipeline. A logger the module had already created is destroyed.
+    //! Passing 0 removes the binding. Both sides must be built from the same QsLog sources with
+    //! the same defines, and the host logger must outlive the binding.
+    //! Only the logger is shared. Each module keeps its own ThreadLevelOverride state (an override
+    //! only affects the statements of the module that created it), call site registry (the admin
+    //! socket and top talkers only see the sites of the module that started them), levels added
+    //! with registerLevel (register them on both sides) and installQtMessageHandler bookkeeping
+    //! (install the handler from one module only).
+    static void bindInstance(Logger* host);
     static Level levelFromLogMessage(const QString& logMessage, bool* conversionSucceeded = 0);
 
+    //! Shuts down using shutdownTimeout(), like destroyInstance.
     ~Logger();
 
-    //! Adds a log message destination. Don't add null destinations.
+    //! Adds a log message destination. Don't add null destinations. The first one added also
+    //! gets the records logged before, see BootBufferOptions.
     void addDestination(DestinationPtr destination);
-    //! Logging at a level < 'newLevel' will be ignored
+    //! See BootBufferOptions. Only has an effect until the first destination is added.
+    void setBootBuffer(const BootBufferOptions& options);
+    BootBufferOptions bootBuffer() const;
+    //! Logging at a built-in level < 'newLevel' will be ignored. Custom levels are not affected.
     void setLoggingLevel(Level newLevel);
     //! The default level is INFO
     Level loggingLevel() const;
+    //! The level the logging macros compare against. It is the same as loggingLevel() unless
+    //! load shedding has temporarily raised it.
+    Level effectiveLoggingLevel() const;
+    //! Registers a custom severity written as 'name', e.g. "AUDIT". Registering a name again
+    //! returns the same level. Returns OffLevel once all custom levels are taken. Custom levels
+    //! are process wide and disabled in every logger until enabled with setLevelEnabled.
+    static Level registerLevel(const QString& name);
+    //! Enables or disables a single level, independently of the logging level threshold.
+    void setLevelEnabled(Level level, bool enabled);
+    //! Enables exactly the given set of levels, built-in and custom.
+    void setEnabledLevels(LevelMask levels);
+    //! The configured set of enabled levels. Load shedding and shutdown can disable more.
+    LevelMask enabledLevels() const;
+    //! Moves the set of levels the logging macros check into a shared memory segment named 'key'
+    //! (see QSharedMemory), where tools/qslogctl can change it from outside the process. The
+    //! macros keep reading it directly; no thread or system call is involved. The page is the
+    //! source of truth: a level the tool enables or disables becomes part of enabledLevels() and
+    //! stays so through load shedding until a level setter of this logger changes it. Returns false if
+    //! the segment can't be created or levels are already shared. Call it at startup, before other
+    //! threads log, and use a key unique to the process, e.g. containing its PID.
+    bool shareLevels(const QString& key);
+    //! The check made by the logging macros: whether a message at 'level' logged from the
+    //! calling thread is written. Honors a ThreadLevelOverride of the calling thread; while no
+    //! thread has one this is a single bit test of the enabled levels.
+    bool isEnabled(Level level) const
+    {
+        if (Q_UNLIKELY(sThreadLevelOverrides.loadAcquire() != 0))
+            return isEnabledWithOverride(level);
+        return (effectiveLevels->loadAcquire() & levelBit(level)) != 0;
+    }
+    //! Whether a statement at this call site logs: its state, unless that is
+    //! CallSite::FollowLevel, which defers to isEnabled(level).
+    bool isEnabled(const CallSite& site, Level level) const
+    {
+        const CallSite::State state = site.state();
+        if (Q_LIKELY(state == CallSite::FollowLevel))
+            return isEnabled(level);
+        return state == CallSite::Enabled;
+    }
+    //! The check made by a logging statement. Like isEnabled(site, level), except that a
+    //! Counted site is counted right here and a Measured site runs so it can be measured.
+    CallSiteCheck check(CallSite& site, Level level) const
+    {
+        site.noteLevel(level);
+        const CallSite::State state = site.state();
+        if (Q_LIKELY(state == CallSite::FollowLevel))
+            return CallSiteCheck(site, isEnabled(level));
+        if (state == CallSite::Counted)
+            site.countRecord(0);
+        return CallSiteCheck(site, state == CallSite::Enabled || state == CallSite::Measured);
+    }
+    //! Configures the adaptive load shedding controller. Disabled by default.
+    void setLoadShedding(const LoadSheddingOptions& options);
+    LoadSheddingOptions loadShedding() const;
+    //! Messages at this level and above get the call stack appended, one frame per line. Only the
+    //! return addresses are taken on the logging thread; they are resolved to symbols by the
+    //! writer. Default is FatalLevel, OffLevel disables it. Custom levels never get a stack.
+    void setStackTraceLevel(Level level);
+    Level stackTraceLevel() const;
+    //! See WriterWatchdogOptions.
+    void setWriterWatchdog(const WriterWatchdogOptions& options);
+    WriterWatchdogOptions writerWatchdog() const;
+    //! Limits the memory used by queued records and destination buffers. Unlimited by default.
+    //! Only has an effect when QS_LOG_SEPARATE_THREAD is defined; without a queue nothing is
+    //! dropped.
+    void setMemoryBudget(const MemoryBudget& budget);
+    MemoryBudget memoryBudget() const;
+    //! Current memory accounting. Also refreshes the destination buffer sizes.
+    MemoryUsage memoryUsage() const;
+    //! Record, byte, drop and latency counters. They are updated without locks; only the per
+    //! destination counters are read under the log mutex.
+    LoggerStatistics statistics() const;
+    //! Disabled by default.
+    void setMetricsExport(const MetricsExportOptions& options);
+    MetricsExportOptions metricsExport() const;
+    //! Asks all destinations to release unneeded buffer capacity. With a separate thread this
+    //! also happens automatically whenever the queue drains.
+    void trimMemory();
+    //! Writes out what the destinations buffer. Records still queued for the writer thread are
+    //! not waited for.
+    void flush();
+    //! Installs a Qt message handler that sends qDebug(), qInfo(), qWarning(), qCritical() and
+    //! qFatal() output to this logger: Debug, Info, Warn, Error and Fatal level respectively. The
+    //! message text is kept as is, prefixed by the file@line, function and category from the
+    //! message context when Qt provides them. A fatal message drains and flushes the logger
+    //! before Qt aborts. Only one logger can be installed at a time.
+    void installQtMessageHandler();
+    //! Restores the handler that was active before installQtMessageHandler.
+    void removeQtMessageHandler();
+    //! Stops accepting messages, waits up to 'drainTimeoutMs' for queued messages to be written
+    //! (-1 waits until all of them are), then flushes and releases the destinations in the order
+    //! they were added. Returns the number of queued messages that were discarded. Logging
+    //! through this logger is a no-op afterwards.
+    int shutdown(int drainTimeoutMs);
+    //! The drain deadline used by destroyInstance and the destructor. Default is 5 seconds.
+    void setShutdownTimeout(int drainTimeoutMs);
+    int shutdownTimeout() const;
+    //! A process forked after the logger was set up gets a fresh writer thread automatically. When
+    //! this is enabled, the child's file destinations also switch to a file named after its PID
+    //! (log.txt becomes log.<pid>.txt, a daily log.txt becomes log.<pid>_<y>_<m>_<d>.txt) instead
+    //! of sharing the parent's file. Default is false.
+    void setSeparateFilesAfterFork(bool enabled);
+    bool separateFilesAfterFork() const;
+    //! Logs text that was produced elsewhere, e.g. captured output, as if it had been streamed
+    //! into one of the logging macros. Messages below the effective level are ignored.
+    void logText(Level level, const QString& text);
     //! Set to false to disable timestamp inclusion in log messages
     void setIncludeTimestamp(bool e);
     //! Default value is true.
@@ -68,7 +327,37 @@ public:
     {
     public:
         explicit Helper(Level logLevel) :
+            logger(Logger::instance()),
+            level(logLevel),
+            site(0),
+            measuredValue(0),
+            hasMeasuredValue(false),
+            qtDebug(&buffer)
+        {}
+        Helper(Logger& targetLogger, Level logLevel) :
+            logger(targetLogger),
+            level(logLevel),
+            site(0),
+            measuredValue(0),
+            hasMeasuredValue(false),
+            qtDebug(&buffer)
+        {}
+        //! counts the message on the statement's call site
+        Helper(Logger& targetLogger, Level logLevel, CallSite& callSite) :
+            logger(targetLogger),
             level(logLevel),
+            site(&callSite),
+            measuredValue(0),
+            hasMeasuredValue(false),
+            qtDebug(&buffer)
+        {}
+        //! a Measured call site records 'value' instead of looking for one in the message
+        Helper(Logger& targetLogger, Level logLevel, CallSite& callSite, qint64 value) :
+            logger(targetLogger),
+            level(logLevel),
+            site(&callSite),
+            measuredValue(value),
+            hasMeasuredValue(true),
             qtDebug(&buffer)
         {}
         ~Helper();
@@ -77,68 +366,112 @@ public:
     private:
         void writeToLog();
 
+        Logger& logger;
         Level level;
+        CallSite* site;
+        qint64 measuredValue;
+        bool hasMeasuredValue;
         QString buffer;
         QDebug qtDebug;
 	};
 
 private:
-    Logger();
     Logger(const Logger&);            // not available
     Logger& operator=(const Logger&); // not available
 
-    void enqueueWrite(const QString& message, Level level);
-    void write(const QString& message, Level level);
+    static Logger& createInstance();
+    bool isEnabledWithOverride(Level level) const;
+    static void handleQtMessage(QtMsgType type, const QMessageLogContext& context,
+                                const QString& message);
+    void enqueueWrite(const QString& message, Level level, const StackFrames& stack = StackFrames());
+    void write(const QString& message, Level level, const StackFrames& stack);
+
+    static Logger* sInstance;
+    static bool sOwnsInstance;
+    //! number of ThreadLevelOverride objects alive in the process
+    static QAtomicInt sThreadLevelOverrides;
 
     LoggerImpl* d;
+    //! cached from d, so the level check in the macros is inlined into the caller
+    const QAtomicInteger<LevelMask>* effectiveLevels;
 
     friend class LogWriterRunnable;
+    friend class ThreadLevelOverride;
+    friend class SignalSafeLog;
+};
+
+//! Makes the calling thread log at built-in 'level' and above through every logger, for as long
+//! as the object lives, while other threads keep the loggers' levels. Custom levels stay as the
+//! logger configures them. E.g. a request that should be traced in detail creates a
+//! ThreadLevelOverride(TraceLevel) when its handling starts. The override replaces the logger's
+//! level in both directions, it can also silence a thread. It is ignored by a logger that is shut
+//! down. Overrides nest; the check in the logging macros only gets slower while at least one
+//! override is alive somewhere in the process.
+class QSLOG_SHARED_OBJECT ThreadLevelOverride
+{
+public:
+    explicit ThreadLevelOverride(Level level);
+    ~ThreadLevelOverride();
+
+    //! Returns whether the calling thread has an override and, if so, stores its level.
+    static bool current(Level* level);
+
+private:
+    ThreadLevelOverride(const ThreadLevelOverride&);            // not available
+    ThreadLevelOverride& operator=(const ThreadLevelOverride&); // not available
+
+    // used by InheritedContext, a negative level means no override
+    explicit ThreadLevelOverride(int level);
+    void install(int level);
+
+    int mPrevious;
+
+    friend class InheritedContext;
 };
 
 } // end namespace
 
 //! Logging macros: define QS_LOG_LINE_NUMBERS to get the file and line number
-//! in the log output.
+//! in the log output. The _TO variants log through the given Logger instead of
+//! Logger::instance(); the logger and level expressions are evaluated twice.
+//! Every statement has a CallSite that can switch it on or off at run time.
 #ifndef QS_LOG_LINE_NUMBERS
-#define QLOG_TRACE() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::TraceLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::TraceLevel).stream()
-#define QLOG_DEBUG() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::DebugLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::DebugLevel).stream()
-#define QLOG_INFO()  \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::InfoLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::InfoLevel).stream()
-#define QLOG_WARN()  \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::WarnLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::WarnLevel).stream()
-#define QLOG_ERROR() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::ErrorLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::ErrorLevel).stream()
-#define QLOG_FATAL() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::FatalLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::FatalLevel).stream()
+#define QS_LOG_LOCATION
 #else
-#define QLOG_TRACE() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::TraceLevel) {} \
-    else  QsLogging::Logger::Helper(QsLogging::TraceLevel).stream() << __FILE__ << '@' << __LINE__
-#define QLOG_DEBUG() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::DebugLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::DebugLevel).stream() << __FILE__ << '@' << __LINE__
-#define QLOG_INFO()  \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::InfoLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::InfoLevel).stream() << __FILE__ << '@' << __LINE__
-#define QLOG_WARN()  \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::WarnLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::WarnLevel).stream() << __FILE__ << '@' << __LINE__
-#define QLOG_ERROR() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::ErrorLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::ErrorLevel).stream() << __FILE__ << '@' << __LINE__
-#define QLOG_FATAL() \
-    if (QsLogging::Logger::instance().loggingLevel() > QsLogging::FatalLevel) {} \
-    else QsLogging::Logger::Helper(QsLogging::FatalLevel).stream() << __FILE__ << '@' << __LINE__
+#define QS_LOG_LOCATION << __FILE__ << '@' << __LINE__
 #endif
 
+#define QS_LOG_STATEMENT(logger, level) \
+    if (const QsLogging::CallSiteCheck qsLogCheck = (logger).check(QS_LOG_CALL_SITE(level), (level))) {} \
+    else QsLogging::Logger::Helper((logger), (level), qsLogCheck.site).stream() QS_LOG_LOCATION
+
+#define QLOG_TRACE_TO(logger) QS_LOG_STATEMENT(logger, QsLogging::TraceLevel)
+#define QLOG_DEBUG_TO(logger) QS_LOG_STATEMENT(logger, QsLogging::DebugLevel)
+#define QLOG_INFO_TO(logger)  QS_LOG_STATEMENT(logger, QsLogging::InfoLevel)
+#define QLOG_WARN_TO(logger)  QS_LOG_STATEMENT(logger, QsLogging::WarnLevel)
+#define QLOG_ERROR_TO(logger) QS_LOG_STATEMENT(logger, QsLogging::ErrorLevel)
+#define QLOG_FATAL_TO(logger) QS_LOG_STATEMENT(logger, QsLogging::FatalLevel)
+#define QLOG_AT_TO(logger, level) QS_LOG_STATEMENT(logger, level)
+
+#define QLOG_TRACE() QLOG_TRACE_TO(QsLogging::Logger::instance())
+#define QLOG_DEBUG() QLOG_DEBUG_TO(QsLogging::Logger::instance())
+#define QLOG_INFO()  QLOG_INFO_TO(QsLogging::Logger::instance())
+#define QLOG_WARN()  QLOG_WARN_TO(QsLogging::Logger::instance())
+#define QLOG_ERROR() QLOG_ERROR_TO(QsLogging::Logger::instance())
+#define QLOG_FATAL() QLOG_FATAL_TO(QsLogging::Logger::instance())
+//! logs at any level, e.g. QLOG_AT(auditLevel) with a level from Logger::registerLevel. The level
+//! may vary between runs, the statement's CallSiteInfo::levels lists each one it ran at.
+#define QLOG_AT(level) QLOG_AT_TO(QsLogging::Logger::instance(), level)
+
+//! Logs like QLOG_AT, and names the value a CallSite::Measured statement records, e.g.
+//! QLOG_MEASURE(QsLogging::DebugLevel, ms) << "request" << id << "took" << ms << "ms". Without it
+//! the first integer in the message is taken, which here would be the id. 'value' is only
+//! evaluated when the statement runs.
+#define QLOG_MEASURE_TO(logger, level, value) \
+    if (const QsLogging::CallSiteCheck qsLogCheck = (logger).check(QS_LOG_CALL_SITE(level), (level))) {} \
+    else QsLogging::Logger::Helper((logger), (level), qsLogCheck.site, (value)).stream() QS_LOG_LOCATION
+#define QLOG_MEASURE(level, value) QLOG_MEASURE_TO(QsLogging::Logger::instance(), level, value)
+
 #ifdef QS_LOG_DISABLE
 #include "QsLogDisableForThisFile.h"
 #endif
@@ -2,11 +2,21 @@ INCLUDEPATH += $$PWD
 #DEFINES += QS_LOG_LINE_NUMBERS    # automatically writes the file and line for each log message
 #DEFINES += QS_LOG_DISABLE         # logging code is replaced with a no-op
 #DEFINES += QS_LOG_SEPARATE_THREAD # messages are queued and written from a separate thread
+linux: LIBS += -ldl                # dladdr, used to resolve stack traces
 SOURCES += $$PWD/QsLogDest.cpp \
     $$PWD/QsLog.cpp \
     $$PWD/QsLogDestConsole.cpp \
     $$PWD/QsLogDestFile.cpp \
-    $$PWD/QsLogDestFunctor.cpp
+    $$PWD/QsLogDestFunctor.cpp \
+    $$PWD/QsLogDestRateLimit.cpp \
+    $$PWD/QsLogOutputCapture.cpp \
+    $$PWD/QsLogContext.cpp \
+    $$PWD/QsLogCallSite.cpp \
+    $$PWD/QsLogMetrics.cpp \
+    $$PWD/QsLogDestHistory.cpp \
+    $$PWD/QsLogAdminSocket.cpp \
+    $$PWD/QsLogStackTrace.cpp \
+    $$PWD/QsLogSignalSafe.cpp
 
 HEADERS += $$PWD/QsLogDest.h \
     $$PWD/QsLog.h \
@@ -14,7 +24,18 @@ HEADERS += $$PWD/QsLogDest.h \
     $$PWD/QsLogLevel.h \
     $$PWD/QsLogDestFile.h \
     $$PWD/QsLogDisableForThisFile.h \
-    $$PWD/QsLogDestFunctor.h
+    $$PWD/QsLogForkLocks.h \
+    $$PWD/QsLogDestFunctor.h \
+    $$PWD/QsLogDestRateLimit.h \
+    $$PWD/QsLogOutputCapture.h \
+    $$PWD/QsLogContext.h \
+    $$PWD/QsLogCallSite.h \
+    $$PWD/QsLogMetrics.h \
+    $$PWD/QsLogDestHistory.h \
+    $$PWD/QsLogAdminSocket.h \
+    $$PWD/QsLogSharedLevels.h \
+    $$PWD/QsLogStackTrace.h \
+    $$PWD/QsLogSignalSafe.h
 
 OTHER_FILES += \
     $$PWD/QsLogChanges.txt \
@@ -0,0 +1,386 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include "QsLogAdminSocket.h"
+#include "QsLog.h"
+#include "QsLogCallSite.h"
+#include "QsLogForkLocks.h"
+#include "QsLogMetrics.h"
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QtGlobal>
+
+namespace QsLogging
+{
+
+static const char HelpText[] =
+    "level <name>             sets the logging level (trace, debug, info, warn, error, fatal, off)\n"
+    "site <pattern> <state>   switches matching statements: follow, on, off, count or measure\n"
+    "flush                    flushes all destinations\n"
+    "stats                    statistics in OpenMetrics text format and the top talkers\n"
+    "history                  messages kept by the history destination\n"
+    "help                     this text\n";
+
+// how many statements the stats command lists as top talkers
+static const int TopTalkerCount = 10;
+
+static bool ParseSiteState(const QString& name, CallSite::State* state)
+{
+    static const struct { const char* name; CallSite::State state; } states[] = {
+        { "follow", CallSite::FollowLevel },
+        { "on", CallSite::Enabled },
+        { "off", CallSite::Disabled },
+        { "count", CallSite::Counted },
+        { "measure", CallSite::Measured }
+    };
+    for (size_t i = 0;i < sizeof(states) / sizeof(states[0]);++i) {
+        if (name == QLatin1String(states[i].name)) {
+            *state = states[i].state;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the whole name must match, case insensitively: "level tracex" is an error
+static bool ParseLevel(const QString& name, Level* level)
+{
+    static const struct { const char* name; Level level; } levels[] = {
+        { "trace", TraceLevel },
+        { "debug", DebugLevel },
+        { "info", InfoLevel },
+        { "warn", WarnLevel },
+        { "error", ErrorLevel },
+        { "fatal", FatalLevel },
+        { "off", OffLevel }
+    };
+    for (size_t i = 0;i < sizeof(levels) / sizeof(levels[0]);++i) {
+        if (name.compare(QLatin1String(levels[i].name), Qt::CaseInsensitive) == 0) {
+            *level = levels[i].level;
+            return true;
+        }
+    }
+    return false;
+}
+
+static QString Error(const QString& reason)
+{
+    return QString::fromLatin1("error: %1\n").arg(reason);
+}
+
+QString AdminSocket::execute(Logger& logger, const AdminSocketOptions& options, const QString& command)
+{
+    const QStringList words = command.simplified().split(QLatin1Char(' '));
+    const QString& name = words.at(0);
+    const QString ok = QString::fromLatin1("ok\n");
+
+    if (name == QLatin1String("level") && words.size() == 2) {
+        Level level;
+        if (!ParseLevel(words.at(1), &level))
+            return Error(QString::fromLatin1("unknown level %1").arg(words.at(1)));
+        logger.setLoggingLevel(level);
+        return ok;
+    }
+    if (name == QLatin1String("site") && words.size() == 3) {
+        CallSite::State state;
+        if (!ParseSiteState(words.at(2), &state))
+            return Error(QString::fromLatin1("unknown state %1").arg(words.at(2)));
+        const int matched = CallSiteRegistry::setState(words.at(1), state);
+        return QString::fromLatin1("%1 statements matched\n").arg(matched) + ok;
+    }
+    if (name == QLatin1String("flush") && words.size() == 1) {
+        logger.flush();
+        return ok;
+    }
+    if (name == QLatin1String("stats") && words.size() == 1) {
+        return OpenMetricsExport::text(logger.statistics())
+            + CallSiteRegistry::topTalkersReport(TopTalkerCount, false) + ok;
+    }
+    if (name == QLatin1String("history") && words.size() == 1) {
+        if (options.history.isNull())
+            return Error(QString::fromLatin1("no history destination"));
+        QString reply;
+        const QStringList messages = options.history->messages();
+        for (int i = 0;i < messages.size();++i)
+            reply.append(messages.at(i)).append(QLatin1Char('\n'));
+        return reply + ok;
+    }
+    if (name == QLatin1String("help") && words.size() == 1)
+        return QString::fromLatin1(HelpText) + ok;
+    return Error(QString::fromLatin1("unknown command, try help"));
+}
+
+}
+
+#if defined(Q_OS_UNIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace QsLogging
+{
+
+// how often the server checks whether it should stop
+static const int PollIntervalMs = 100;
+// a client that sends nothing for this long is disconnected
+static const int ClientIdleTimeoutMs = 30000;
+// a longer command line disconnects the client
+static const int MaxCommandBytes = 4096;
+
+class AdminServer : public QThread
+{
+public:
+    AdminServer(Logger& logger, const AdminSocketOptions& options, int listenFd);
+
+    void requestStop();
+    int listenFd() const { return mListenFd; }
+    const AdminSocketOptions& options() const { return mOptions; }
+
+protected:
+    void run() override;
+
+private:
+    void serve(int clientFd);
+    bool reply(int clientFd, const QString& text);
+
+    Logger& mLogger;
+    AdminSocketOptions mOptions;
+    int mListenFd;
+    QAtomicInt mStopRequested;
+};
+
+static QMutex sAdminMutex;
+static AdminServer* sServer = 0;
+
+QMutex& AdminSocketMutex()
+{
+    return sAdminMutex;
+}
+
+// The server thread doesn't exist in the child, and the socket belongs to the parent. The object
+// can't be deleted while it believes its thread runs, it is left behind.
+void AdminSocketAfterFork()
+{
+    if (!sServer)
+        return;
+    ::close(sServer->listenFd());
+    sServer = 0;
+}
+
+AdminServer::AdminServer(Logger& logger, const AdminSocketOptions& options, int listenFd)
+    : mLogger(logger)
+    , mOptions(options)
+    , mListenFd(listenFd)
+    , mStopRequested(0)
+{
+}
+
+void AdminServer::requestStop()
+{
+    mStopRequested.storeRelease(1);
+}
+
+void AdminServer::run()
+{
+    while (!mStopRequested.loadAcquire()) {
+        pollfd listening;
+        listening.fd = mListenFd;
+        listening.events = POLLIN;
+        listening.revents = 0;
+        if (poll(&listening, 1, PollIntervalMs) <= 0)
+            continue;
+        const int clientFd = ::accept(mListenFd, 0, 0);
+        if (clientFd < 0)
+            continue;
+        ::fcntl(clientFd, F_SETFD, FD_CLOEXEC);
+        serve(clientFd);
+        ::close(clientFd);
+    }
+}
+
+// one client at a time, until it disconnects, idles or the server stops
+void AdminServer::serve(int clientFd)
+{
+    QByteArray pending;
+    int idleMs = 0;
+    while (!mStopRequested.loadAcquire() && idleMs < ClientIdleTimeoutMs) {
+        pollfd client;
+        client.fd = clientFd;
+        client.events = POLLIN;
+        client.revents = 0;
+        if (poll(&client, 1, PollIntervalMs) <= 0) {
+            idleMs += PollIntervalMs;
+            continue;
+        }
+        idleMs = 0;
+
+        char buffer[1024];
+        const ssize_t count = ::read(clientFd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return;
+        pending.append(buffer, static_cast<int>(count));
+
+        int end;
+        while ((end = pending.indexOf('\n')) >= 0) {
+            const QString command = QString::fromUtf8(pending.constData(), end).trimmed();
+            pending.remove(0, end + 1);
+            if (!command.isEmpty() && !reply(clientFd, AdminSocket::execute(mLogger, mOptions, command)))
+                return;
+        }
+        if (pending.size() > MaxCommandBytes)
+            return;
+    }
+}
+
+bool AdminServer::reply(int clientFd, const QString& text)
+{
+    const QByteArray data = text.toUtf8();
+    qint64 written = 0;
+    while (written < data.size()) {
+        const ssize_t count = ::send(clientFd, data.constData() + written,
+                                     static_cast<size_t>(data.size() - written), MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        written += count;
+    }
+    return true;
+}
+
+// Only a stale socket is replaced: never another kind of file, nor a socket that another process
+// still listens on. The probe doesn't block, a busy listener counts as alive.
+static void RemoveStaleSocket(const sockaddr_un& address)
+{
+    struct stat info;
+    if (::lstat(address.sun_path, &info) != 0 || !S_ISSOCK(info.st_mode))
+        return;
+    const int probeFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probeFd < 0)
+        return;
+    ::fcntl(probeFd, F_SETFL, O_NONBLOCK);
+    const bool refused = ::connect(probeFd, reinterpret_cast<const sockaddr*>(&address),
+                                   sizeof(address)) != 0 && errno == ECONNREFUSED;
+    ::close(probeFd);
+    if (refused)
+        ::unlink(address.sun_path);
+}
+
+bool AdminSocket::start(Logger& logger, const AdminSocketOptions& options)
+{
+    QMutexLocker lock(&sAdminMutex);
+    if (sServer)
+        return false;
+
+    const QByteArray path = QFile::encodeName(options.socketPath);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    if (path.isEmpty() || static_cast<size_t>(path.size()) >= sizeof(address.sun_path))
+        return false;
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.constData(), static_cast<size_t>(path.size()));
+
+    const int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        return false;
+    ::fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    RemoveStaleSocket(address);
+    // the socket file is created with the umask's permissions; restricting them only afterwards
+    // would leave a window in which other users could connect. umask is process wide: a file
+    // another thread creates meanwhile is private too, which errs on the safe side.
+    const mode_t previousMask = ::umask(S_IRWXG | S_IRWXO);
+    const int bound = ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    ::umask(previousMask);
+    if (bound != 0) {
+        ::close(listenFd);
+        return false;
+    }
+    if (::chmod(path.constData(), S_IRUSR | S_IWUSR) != 0 || ::listen(listenFd, 4) != 0) {
+        ::close(listenFd);
+        ::unlink(path.constData());
+        return false;
+    }
+
+    sServer = new AdminServer(logger, options, listenFd);
+    sServer->start();
+    return true;
+}
+
+void AdminSocket::stop()
+{
+    QMutexLocker lock(&sAdminMutex);
+    if (!sServer)
+        return;
+
+    sServer->requestStop();
+    sServer->wait();
+    ::close(sServer->listenFd());
+    ::unlink(QFile::encodeName(sServer->options().socketPath).constData());
+    delete sServer;
+    sServer = 0;
+}
+
+bool AdminSocket::isActive()
+{
+    QMutexLocker lock(&sAdminMutex);
+    return sServer != 0;
+}
+
+} // end namespace
+
+#else
+
+bool QsLogging::AdminSocket::start(Logger&, const AdminSocketOptions&)
+{
+    return false;
+}
+
+void QsLogging::AdminSocket::stop()
+{
+}
+
+bool QsLogging::AdminSocket::isActive()
+{
+    return false;
+}
+
+#endif
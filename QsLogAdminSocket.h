@@ -0,0 +1,76 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef QSLOGADMINSOCKET_H
+#define QSLOGADMINSOCKET_H
+
+#include "QsLogDestHistory.h"
+#include <QSharedPointer>
+#include <QString>
+
+namespace QsLogging
+{
+class Logger;
+
+struct QSLOG_SHARED_OBJECT AdminSocketOptions
+{
+    //! path of the Unix domain socket; an existing socket file there is replaced
+    QString socketPath;
+    //! dumped by the "history" command when set; it must also be added to the logger
+    QSharedPointer<HistoryDestination> history;
+};
+
+//! A Unix domain socket, served by a background thread, through which operators can inspect and
+//! tune the logging of a running process, e.g. with "echo 'level debug' | socat - UNIX:app.sock".
+//! Each line is a command and is answered with text ending in "ok" or "error: ...":
+//!   level <name>             sets the logging level (trace ... fatal, off)
+//!   site <pattern> <state>   CallSiteRegistry::setState, state is one of follow, on, off,
+//!                            count or measure
+//!   flush                    flushes all destinations
+//!   stats                    the statistics in OpenMetrics text format and the top talkers
+//!   history                  the messages kept by the history destination
+//!   help                     lists the commands
+//! The logging path is not involved at all. The socket is only accessible by the owner. Only
+//! implemented on Unix, start() returns false elsewhere. Process wide like StandardOutputCapture:
+//! there is at most one socket and it must be stopped before its logger is destroyed.
+class QSLOG_SHARED_OBJECT AdminSocket
+{
+public:
+    //! Fails if a socket is already active, or another process listens on the path. A socket
+    //! file left behind by a process that is gone is replaced.
+    static bool start(Logger& logger, const AdminSocketOptions& options);
+    //! Closes the socket and removes its file. In a forked child there is nothing to stop, the
+    //! socket belongs to the parent.
+    static void stop();
+    static bool isActive();
+    //! Runs one command line and returns the reply, as the socket does.
+    static QString execute(Logger& logger, const AdminSocketOptions& options, const QString& command);
+};
+
+}
+
+#endif // QSLOGADMINSOCKET_H
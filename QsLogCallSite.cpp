@@ -0,0 +1,356 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "QsLogCallSite.h"
+#include "QsLogForkLocks.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+#include <algorithm>
+#include <limits>
+
+namespace QsLogging
+{
+
+enum { HistogramBuckets = 32 };
+
+struct CallSiteValues
+{
+    CallSiteValues() : sum(0) {}
+
+    QAtomicInteger<qint64> sum;
+    QAtomicInteger<qint64> buckets[HistogramBuckets]; // zero initialized
+};
+
+struct CallSiteRule
+{
+    QString pattern;
+    CallSite::State state;
+};
+
+struct CallSiteList
+{
+    CallSiteList() : head(0) { window.start(); }
+
+    QMutex mutex;
+    CallSite* head;
+    QVector<CallSiteRule> rules;
+    QElapsedTimer window;
+};
+
+// function local, statements can run during static initialization
+static CallSiteList& Sites()
+{
+    static CallSiteList sites;
+    return sites;
+}
+
+QMutex& CallSiteMutex()
+{
+    return Sites().mutex;
+}
+
+// '*' matches any run of characters, '?' any single character
+static bool WildcardMatch(const QChar* pattern, const QChar* patternEnd,
+                          const QChar* text, const QChar* textEnd)
+{
+    while (pattern != patternEnd) {
+        if (*pattern == QLatin1Char('*')) {
+            for (const QChar* rest = text;;++rest) {
+                if (WildcardMatch(pattern + 1, patternEnd, rest, textEnd))
+                    return true;
+                if (rest == textEnd)
+                    return false;
+            }
+        }
+        if (text == textEnd || (*pattern != QLatin1Char('?') && *pattern != *text))
+            return false;
+        ++pattern;
+        ++text;
+    }
+    return text == textEnd;
+}
+
+static bool WildcardMatch(const QString& pattern, const QString& text)
+{
+    return WildcardMatch(pattern.constData(), pattern.constData() + pattern.size(),
+                         text.constData(), text.constData() + text.size());
+}
+
+static bool Matches(const CallSite& site, const QString& pattern)
+{
+    const QString location = QString::fromLocal8Bit(site.file) + QLatin1Char(':')
+        + QString::number(site.line);
+    return WildcardMatch(pattern, location)
+        || WildcardMatch(pattern, QString::fromLatin1(site.function));
+}
+
+CallSite::CallSite(const char* file_, int line_, const char* function_, Level level_)
+    : file(file_)
+    , line(line_)
+    , function(function_)
+    , mState(FollowLevel)
+    , mLevels(levelBit(level_))
+    , mWindowRecords(0)
+    , mWindowBytes(0)
+    , mValues(0)
+    , mNext(0)
+{
+    CallSiteRegistry::add(this);
+}
+
+CallSite::~CallSite()
+{
+    // a plugin that is unloaded takes its statements with it
+    CallSiteRegistry::remove(this);
+    delete mValues.loadAcquire();
+}
+
+// With QS_LOG_LINE_NUMBERS a message starts with its statement's "file@line", which isn't part of
+// the measured value. Returns where the text after that prefix starts, 0 if there is none.
+static int SkipLocation(const QString& text, const CallSite& site)
+{
+    const QString file = QString::fromLocal8Bit(site.file);
+    if (!text.startsWith(file))
+        return 0;
+    const QString line = QString::number(site.line);
+    const int at = text.indexOf(line, file.size());
+    return at < 0 ? 0 : at + line.size();
+}
+
+// the first integer in the text from 'from' on, with its sign; false if there is none. Values
+// beyond the range of qint64 are clamped to it.
+static bool FirstInteger(const QString& text, int from, qint64* value)
+{
+    const qint64 max = std::numeric_limits<qint64>::max();
+    for (int i = from;i < text.size();++i) {
+        if (!text.at(i).isDigit())
+            continue;
+        const bool negative = i > from && text.at(i - 1) == QLatin1Char('-');
+        qint64 result = 0;
+        for (;i < text.size() && text.at(i).isDigit();++i) {
+            const int digit = text.at(i).digitValue();
+            result = result > (max - digit) / 10 ? max : result * 10 + digit;
+        }
+        *value = negative ? -result : result;
+        return true;
+    }
+    return false;
+}
+
+static int BucketFor(qint64 value)
+{
+    int bucket = 0;
+    while (bucket < HistogramBuckets - 1 && value > (Q_INT64_C(1) << bucket))
+        ++bucket;
+    return bucket;
+}
+
+void CallSite::measure(const QString& message)
+{
+    qint64 value;
+    if (FirstInteger(message, SkipLocation(message, *this), &value))
+        measure(value);
+    else
+        countRecord(0);
+}
+
+void CallSite::measure(qint64 value)
+{
+    countRecord(0);
+    CallSiteValues* values = mValues.loadAcquire();
+    if (!values) {
+        CallSiteValues* created = new CallSiteValues;
+        if (mValues.testAndSetOrdered(0, created))
+            values = created;
+        else {
+            delete created;
+            values = mValues.loadAcquire();
+        }
+    }
+    values->sum.fetchAndAddRelaxed(value);
+    values->buckets[BucketFor(value)].fetchAndAddRelaxed(1);
+}
+
+void CallSiteRegistry::add(CallSite* site)
+{
+    CallSiteList& sites = Sites();
+    QMutexLocker lock(&sites.mutex);
+    for (int i = sites.rules.size() - 1;i >= 0;--i) {
+        if (Matches(*site, sites.rules.at(i).pattern)) {
+            site->mState.storeRelease(sites.rules.at(i).state);
+            break;
+        }
+    }
+    site->mNext = sites.head;
+    sites.head = site;
+}
+
+void CallSiteRegistry::remove(CallSite* site)
+{
+    CallSiteList& sites = Sites();
+    QMutexLocker lock(&sites.mutex);
+    for (CallSite** link = &sites.head;*link;link = &(*link)->mNext) {
+        if (*link == site) {
+            *link = site->mNext;
+            break;
+        }
+    }
+}
+
+int CallSiteRegistry::setState(const QString& pattern, CallSite::State state)
+{
+    CallSiteList& sites = Sites();
+    QMutexLocker lock(&sites.mutex);
+    // a rule for every site supersedes all older ones
+    if (pattern == QLatin1String("*"))
+        sites.rules.clear();
+    for (int i = 0;i < sites.rules.size();++i) {
+        if (sites.rules.at(i).pattern == pattern) {
+            sites.rules.remove(i);
+            break;
+        }
+    }
+    CallSiteRule rule;
+    rule.pattern = pattern;
+    rule.state = state;
+    sites.rules.push_back(rule);
+
+    int matched = 0;
+    for (CallSite* site = sites.head;site;site = site->mNext) {
+        if (Matches(*site, pattern)) {
+            site->mState.storeRelease(state);
+            ++matched;
+        }
+    }
+    return matched;
+}
+
+static CallSiteInfo Describe(const CallSite& site)
+{
+    CallSiteInfo info;
+    info.file = QString::fromLocal8Bit(site.file);
+    info.line = site.line;
+    info.function = QString::fromLatin1(site.function);
+    info.levels = site.levels();
+    for (int level = TraceLevel;level <= LastCustomLevel;++level) {
+        if (info.levels & levelBit(static_cast<Level>(level))) {
+            info.level = static_cast<Level>(level);
+            break;
+        }
+    }
+    info.state = site.state();
+    return info;
+}
+
+QList<CallSiteInfo> CallSiteRegistry::sites(const QString& pattern)
+{
+    CallSiteList& sites = Sites();
+    QMutexLocker lock(&sites.mutex);
+    QList<CallSiteInfo> result;
+    for (CallSite* site = sites.head;site;site = site->mNext) {
+        if (!Matches(*site, pattern))
+            continue;
+        CallSiteInfo info = Describe(*site);
+        info.records = site->mCounters.records.loadAcquire();
+        info.bytes = site->mCounters.bytes.loadAcquire();
+        if (const CallSiteValues* values = site->mValues.loadAcquire()) {
+            info.sum = values->sum.loadAcquire();
+            for (int i = 0;i < HistogramBuckets;++i)
+                info.buckets.push_back(values->buckets[i].loadAcquire());
+        }
+        result.push_back(info);
+    }
+    return result;
+}
+
+QList<CallSiteInfo> CallSiteRegistry::metrics()
+{
+    QList<CallSiteInfo> result;
+    const QList<CallSiteInfo> all = sites();
+    for (int i = 0;i < all.size();++i) {
+        if (all.at(i).state == CallSite::Counted || all.at(i).state == CallSite::Measured)
+            result.push_back(all.at(i));
+    }
+    return result;
+}
+
+static bool MoreBytes(const CallSiteInfo& a, const CallSiteInfo& b)
+{
+    return a.bytes > b.bytes;
+}
+
+QList<CallSiteInfo> CallSiteRegistry::topTalkers(int count, bool restartWindow)
+{
+    CallSiteList& sites = Sites();
+    QMutexLocker lock(&sites.mutex);
+    QVector<CallSiteInfo> talkers;
+    for (CallSite* site = sites.head;site;site = site->mNext) {
+        const qint64 records = site->mCounters.records.loadAcquire();
+        const qint64 bytes = site->mCounters.bytes.loadAcquire();
+        if (records != site->mWindowRecords) {
+            CallSiteInfo info = Describe(*site);
+            info.records = records - site->mWindowRecords;
+            info.bytes = bytes - site->mWindowBytes;
+            talkers.push_back(info);
+        }
+        if (restartWindow) {
+            site->mWindowRecords = records;
+            site->mWindowBytes = bytes;
+        }
+    }
+    if (restartWindow)
+        sites.window.restart();
+
+    std::sort(talkers.begin(), talkers.end(), MoreBytes);
+    QList<CallSiteInfo> result;
+    for (int i = 0;i < talkers.size() && i < count;++i)
+        result.push_back(talkers.at(i));
+    return result;
+}
+
+QString CallSiteRegistry::topTalkersReport(int count, bool restartWindow)
+{
+    qint64 windowMs;
+    {
+        CallSiteList& sites = Sites();
+        QMutexLocker lock(&sites.mutex);
+        windowMs = sites.window.elapsed();
+    }
+    const QList<CallSiteInfo> talkers = topTalkers(count, restartWindow);
+
+    QString report = QString::fromLatin1("top %1 statements by volume over the last %2 s\n")
+        .arg(count).arg(windowMs / 1000.0, 0, 'f', 1);
+    for (int i = 0;i < talkers.size();++i) {
+        const CallSiteInfo& talker = talkers.at(i);
+        report.append(QString::fromLatin1("%1 bytes %2 records %3:%4 %5\n")
+                      .arg(talker.bytes, 12).arg(talker.records, 9)
+                      .arg(talker.file).arg(talker.line).arg(talker.function));
+    }
+    return report;
+}
+
+}
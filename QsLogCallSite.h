@@ -0,0 +1,187 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef QSLOGCALLSITE_H
+#define QSLOGCALLSITE_H
+
+#include "QsLogLevel.h"
+#include "QsLogDest.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+namespace QsLogging
+{
+
+struct CallSiteValues;
+
+//! The static record every logging statement keeps. It is created and registered the first time
+//! the statement runs; its state decides whether the statement logs. It also counts what the
+//! statement logs. Each site has its own cache line, so the counters are never contended.
+class QSLOG_SHARED_OBJECT CallSite
+{
+public:
+    enum State
+    {
+        FollowLevel = 0, //!< the logger's levels decide, the default
+        Enabled,         //!< always logs, whatever the level
+        Disabled,        //!< never logs
+        Counted,         //!< doesn't log, only counts its records; the message isn't even built
+        Measured         //!< doesn't log, adds a value to a histogram: the one given to
+                         //!< QLOG_MEASURE, else the first integer in the message (after the
+                         //!< file@line of QS_LOG_LINE_NUMBERS), whatever it stands for
+    };
+
+    CallSite(const char* file, int line, const char* function, Level level);
+    ~CallSite();
+
+    State state() const
+    {
+        return static_cast<State>(mState.loadAcquire());
+    }
+
+    //! called by the statement every time it runs, with the level it runs at. The level is
+    //! usually a constant, only QLOG_AT with a variable adds more.
+    void noteLevel(Level level)
+    {
+        const LevelMask bit = levelBit(level);
+        if (Q_UNLIKELY(!(mLevels.loadAcquire() & bit)))
+            mLevels.fetchAndOrRelaxed(bit);
+    }
+    //! the levels the statement ran at
+    LevelMask levels() const
+    {
+        return mLevels.loadAcquire();
+    }
+
+    //! called by the statement for every message it logs
+    void countRecord(qint64 bytes)
+    {
+        mCounters.records.fetchAndAddRelaxed(1);
+        mCounters.bytes.fetchAndAddRelaxed(bytes);
+    }
+    //! called by a Measured statement with the message it built instead of logging it
+    void measure(const QString& message);
+    //! called by a Measured QLOG_MEASURE statement with its value
+    void measure(qint64 value);
+
+    const char* const file;
+    const int line;
+    const char* const function;
+
+private:
+    CallSite(const CallSite&);            // not available
+    CallSite& operator=(const CallSite&); // not available
+
+    QAtomicInt mState;
+    // on the state's cache line, which the statement reads anyway
+    QAtomicInteger<LevelMask> mLevels;
+    // aligned to a cache line, which also aligns and pads the whole site to one
+    struct alignas(64) Counters
+    {
+        Counters() : records(0), bytes(0) {}
+        QAtomicInteger<qint64> records;
+        QAtomicInteger<qint64> bytes;
+    } mCounters;
+    // the counters when the current top talkers window started, guarded by the registry
+    qint64 mWindowRecords;
+    qint64 mWindowBytes;
+    // allocated by the first measure()
+    QAtomicPointer<CallSiteValues> mValues;
+    CallSite* mNext;
+
+    friend class CallSiteRegistry;
+};
+
+//! The result of a logging statement's check. It converts to true when the statement is skipped,
+//! which lets QS_LOG_STATEMENT declare it in its if condition and pass the call site on to the
+//! else branch.
+struct CallSiteCheck
+{
+    CallSiteCheck(CallSite& site_, bool enabled_) : site(site_), enabled(enabled_) {}
+    explicit operator bool() const { return !enabled; }
+
+    CallSite& site;
+    bool enabled;
+};
+
+struct QSLOG_SHARED_OBJECT CallSiteInfo
+{
+    CallSiteInfo()
+        : line(0), level(InfoLevel), levels(0), state(CallSite::FollowLevel), records(0), bytes(0), sum(0) {}
+    QString file;
+    int line;
+    QString function;
+    Level level;      //!< the lowest of 'levels'
+    //! Every level the statement ran at. More than one for QLOG_AT(level) with a variable level;
+    //! the counters below are not split by level.
+    LevelMask levels;
+    CallSite::State state;
+    qint64 records; //!< messages logged, since start or within the top talkers window
+    qint64 bytes;   //!< characters of those messages, including level and timestamp
+    //! Histogram of the values a Measured statement captured, empty if it never was. Bucket i
+    //! counts the values up to 2^i, the last one everything larger. Not windowed.
+    QVector<qint64> buckets;
+    qint64 sum;     //!< sum of the captured values
+};
+
+//! Lists and switches logging statements at run time, like Linux' dynamic debug. A pattern is
+//! matched against "file:line" and against the function name; '*' matches any run of characters
+//! and '?' a single one, e.g. "*network.cpp:*" or "*Parser::parse*". Since statements only
+//! register when they first run, each setState is also remembered as a rule and applied to
+//! statements that register later; when rules overlap the newest one wins.
+class QSLOG_SHARED_OBJECT CallSiteRegistry
+{
+public:
+    //! Returns the number of registered statements that matched.
+    static int setState(const QString& pattern, CallSite::State state);
+    static QList<CallSiteInfo> sites(const QString& pattern = QString(QLatin1String("*")));
+    //! The Counted and Measured statements, i.e. the metrics derived from logging statements.
+    static QList<CallSiteInfo> metrics();
+    //! The at most 'count' statements that logged the most bytes since the window started, i.e.
+    //! since the previous call with 'restartWindow' set or since the program started.
+    static QList<CallSiteInfo> topTalkers(int count, bool restartWindow = true);
+    //! topTalkers() as readable text, one statement per line.
+    static QString topTalkersReport(int count, bool restartWindow = true);
+
+private:
+    friend class CallSite;
+    static void add(CallSite* site);
+    static void remove(CallSite* site);
+};
+
+}
+
+//! The call site of the logging statement this is expanded in. The function name is evaluated
+//! outside the lambda so that it names the enclosing function.
+#define QS_LOG_CALL_SITE(level) \
+    ([](const char* qsLogFunction, QsLogging::Level qsLogLevel) -> QsLogging::CallSite& { \
+        static QsLogging::CallSite qsLogSite(__FILE__, __LINE__, qsLogFunction, qsLogLevel); \
+        return qsLogSite; }(Q_FUNC_INFO, (level)))
+
+#endif // QSLOGCALLSITE_H
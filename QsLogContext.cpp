@@ -0,0 +1,122 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "QsLogContext.h"
+
+namespace QsLogging
+{
+
+struct ThreadContext
+{
+    ThreadContext() : dirty(false) {}
+
+    QVector<ContextEntry> entries;
+    QString rendered;
+    bool dirty;
+};
+
+static thread_local ThreadContext sThreadContext;
+
+ContextScope::ContextScope(const QString& key, const QString& value)
+{
+    sThreadContext.entries.push_back(qMakePair(key, value));
+    sThreadContext.dirty = true;
+}
+
+ContextScope::~ContextScope()
+{
+    sThreadContext.entries.pop_back();
+    sThreadContext.dirty = true;
+}
+
+QString DiagnosticContext::rendered()
+{
+    ThreadContext& context = sThreadContext;
+    if (context.dirty) {
+        context.rendered.clear();
+        if (!context.entries.isEmpty()) {
+            context.rendered.append('[');
+            for (int i = 0;i < context.entries.size();++i) {
+                if (i)
+                    context.rendered.append(' ');
+                context.rendered.append(context.entries.at(i).first).append('=')
+                    .append(context.entries.at(i).second);
+            }
+            context.rendered.append(QLatin1String("] "));
+        }
+        context.dirty = false;
+    }
+    return context.rendered;
+}
+
+ContextSnapshot ContextSnapshot::capture()
+{
+    ContextSnapshot snapshot;
+    snapshot.mRendered = DiagnosticContext::rendered();
+    snapshot.mEntries = sThreadContext.entries;
+    Level level;
+    if (ThreadLevelOverride::current(&level))
+        snapshot.mLevelOverride = level;
+    return snapshot;
+}
+
+InheritedContext::InheritedContext(const ContextSnapshot& snapshot)
+    : mPrevious(ContextSnapshot::capture())
+    , mLevel(snapshot.mLevelOverride)
+{
+    ThreadContext& context = sThreadContext;
+    context.entries = snapshot.mEntries;
+    context.rendered = snapshot.mRendered;
+    context.dirty = false;
+}
+
+InheritedContext::~InheritedContext()
+{
+    ThreadContext& context = sThreadContext;
+    context.entries = mPrevious.mEntries;
+    context.rendered = mPrevious.mRendered;
+    context.dirty = false;
+}
+
+ContextRunnable::ContextRunnable(QRunnable* task)
+    : mTask(task)
+    , mContext(ContextSnapshot::capture())
+{
+}
+
+ContextRunnable::~ContextRunnable()
+{
+    if (mTask->autoDelete())
+        delete mTask;
+}
+
+void ContextRunnable::run()
+{
+    InheritedContext context(mContext);
+    mTask->run();
+}
+
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef QSLOGCONTEXT_H
+#define QSLOGCONTEXT_H
+
+#include "QsLog.h"
+#include <QPair>
+#include <QRunnable>
+#include <QString>
+#include <QVector>
+#include <utility>
+
+namespace QsLogging
+{
+typedef QPair<QString, QString> ContextEntry;
+
+//! Adds a key/value pair to the calling thread's diagnostic context for as long as it lives.
+//! Every message logged from that thread meanwhile carries the context after its timestamp,
+//! e.g. "INFO  2013-05-01T12:00:00.000 [request=42 tenant=acme] message". Scopes nest and must
+//! be destroyed in reverse order of creation, which is what happens to local variables.
+class QSLOG_SHARED_OBJECT ContextScope
+{
+public:
+    ContextScope(const QString& key, const QString& value);
+    ~ContextScope();
+
+private:
+    ContextScope(const ContextScope&);            // not available
+    ContextScope& operator=(const ContextScope&); // not available
+};
+
+class QSLOG_SHARED_OBJECT DiagnosticContext
+{
+public:
+    //! The calling thread's context as it is written to the log, including the trailing space,
+    //! or an empty string. It is only rebuilt after a scope was entered or left, otherwise the
+    //! cached string is shared with the caller.
+    static QString rendered();
+};
+
+//! A copy of a thread's diagnostic context and ThreadLevelOverride that can be installed on
+//! another thread, see InheritedContext. Copying it only increases reference counts.
+class QSLOG_SHARED_OBJECT ContextSnapshot
+{
+public:
+    ContextSnapshot() : mLevelOverride(-1) {}
+    //! The calling thread's current context.
+    static ContextSnapshot capture();
+
+private:
+    friend class InheritedContext;
+
+    QVector<ContextEntry> mEntries;
+    QString mRendered;
+    int mLevelOverride; // negative when there is none
+};
+
+//! Replaces the calling thread's context and level override with those in 'snapshot' for as long
+//! as it lives, then restores what the thread had before.
+class QSLOG_SHARED_OBJECT InheritedContext
+{
+public:
+    explicit InheritedContext(const ContextSnapshot& snapshot);
+    ~InheritedContext();
+
+private:
+    InheritedContext(const InheritedContext&);            // not available
+    InheritedContext& operator=(const InheritedContext&); // not available
+
+    ContextSnapshot mPrevious;
+    ThreadLevelOverride mLevel;
+};
+
+//! Runs another runnable with the context of the thread that created the wrapper, e.g.
+//! QThreadPool::globalInstance()->start(new ContextRunnable(task)). 'task' is deleted with the
+//! wrapper if its autoDelete() is set.
+class QSLOG_SHARED_OBJECT ContextRunnable : public QRunnable
+{
+public:
+    explicit ContextRunnable(QRunnable* task);
+    ~ContextRunnable();
+
+    void run() override;
+
+private:
+    QRunnable* mTask;
+    ContextSnapshot mContext;
+};
+
+//! A callable that invokes 'F' with the context captured when it was created, see WithLogContext.
+template <typename F>
+class ContextBoundCall
+{
+public:
+    explicit ContextBoundCall(const F& function)
+        : mFunction(function)
+        , mContext(ContextSnapshot::capture())
+    {}
+
+    auto operator()() -> decltype(std::declval<F&>()())
+    {
+        InheritedContext context(mContext);
+        return mFunction();
+    }
+
+private:
+    F mFunction;
+    ContextSnapshot mContext;
+};
+
+//! Wraps a function object so that it runs with the calling thread's context wherever it is
+//! called, e.g. QtConcurrent::run(WithLogContext(task)) or
+//! QThreadPool::globalInstance()->start(WithLogContext([]{ ... })).
+template <typename F>
+ContextBoundCall<F> WithLogContext(const F& function)
+{
+    return ContextBoundCall<F>(function);
+}
+
+}
+
+#endif // QSLOGCONTEXT_H
@@ -27,6 +27,7 @@
 #include "QsLogDestConsole.h"
 #include "QsLogDestFile.h"
 #include "QsLogDestFunctor.h"
+#include "QsLogDestRateLimit.h"
 #include <QString>
 
 namespace QsLogging
@@ -36,30 +37,153 @@ Destination::~Destination()
 {
 }
 
+qint64 Destination::bufferedBytes()
+{
+    return 0;
+}
+
+void Destination::trimBuffers()
+{
+}
+
+void Destination::flush()
+{
+}
+
+void Destination::afterFork(bool)
+{
+}
+
+qint64 Destination::rotationCount()
+{
+    return 0;
+}
+
+const DestinationHealth* Destination::health() const
+{
+    return 0;
+}
+
+qint64 Destination::droppedMessages() const
+{
+    return 0;
+}
+
+const int DestinationHealth::TripThreshold = 3;
+const int DestinationHealth::InitialRetryDelayMs = 1000;
+const int DestinationHealth::MaxRetryDelayMs = 60000;
+
+DestinationHealth::DestinationHealth()
+    : mRetryAtMs(0)
+    , mRetryDelayMs(InitialRetryDelayMs)
+    , mConsecutiveFailures(0)
+    , mTripped(0)
+    , mFailures(0)
+    , mSkipped(0)
+    , mTrips(0)
+{
+    mClock.start();
+}
+
+bool DestinationHealth::shouldAttempt()
+{
+    if (!mTripped.loadAcquire() || mClock.elapsed() >= mRetryAtMs)
+        return true;
+
+    mSkipped.fetchAndAddRelaxed(1);
+    return false;
+}
+
+bool DestinationHealth::recordSuccess()
+{
+    mConsecutiveFailures = 0;
+    mRetryDelayMs = InitialRetryDelayMs;
+    if (!mTripped.loadAcquire())
+        return false;
+
+    mTripped.storeRelease(0);
+    return true;
+}
+
+bool DestinationHealth::recordFailure()
+{
+    mFailures.fetchAndAddRelaxed(1);
+    ++mConsecutiveFailures;
+    if (mTripped.loadAcquire()) {
+        // a retry failed, back off further
+        mRetryDelayMs = qMin(mRetryDelayMs * 2, MaxRetryDelayMs);
+        mRetryAtMs = mClock.elapsed() + mRetryDelayMs;
+        return false;
+    }
+    if (mConsecutiveFailures < TripThreshold)
+        return false;
+
+    mRetryDelayMs = InitialRetryDelayMs;
+    mRetryAtMs = mClock.elapsed() + mRetryDelayMs;
+    mTrips.fetchAndAddRelaxed(1);
+    mTripped.storeRelease(1);
+    return true;
+}
+
+bool DestinationHealth::isTripped() const
+{
+    return mTripped.loadAcquire() != 0;
+}
+
+int DestinationHealth::retryDelayMs() const
+{
+    return mRetryDelayMs;
+}
+
+int DestinationHealth::consecutiveFailures() const
+{
+    return mConsecutiveFailures;
+}
+
+qint64 DestinationHealth::failureCount() const
+{
+    return mFailures.loadAcquire();
+}
+
+qint64 DestinationHealth::skippedCount() const
+{
+    return mSkipped.loadAcquire();
+}
+
+qint64 DestinationHealth::tripCount() const
+{
+    return mTrips.loadAcquire();
+}
+
 //! destination factory
 DestinationPtr DestinationFactory::MakeFileDestination(const QString& filePath,
     LogRotationOption rotation, const MaxSizeBytes &sizeInBytesToRotateAfter,
-    const MaxOldLogCount &oldLogsToKeep)
+    const MaxOldLogCount &oldLogsToKeep, DestinationPtr fallback)
 {
     if (EnableLogRotation == rotation) {
         QScopedPointer<SizeRotationStrategy> logRotation(new SizeRotationStrategy);
         logRotation->setMaximumSizeInBytes(sizeInBytesToRotateAfter.size);
         logRotation->setBackupCount(oldLogsToKeep.count);
 
-        return DestinationPtr(new FileDestination(filePath, RotationStrategyPtr(logRotation.take())));
+        return DestinationPtr(new FileDestination(filePath, RotationStrategyPtr(logRotation.take()),
+                                                  fallback));
     }
 
-    return DestinationPtr(new FileDestination(filePath, RotationStrategyPtr(new NullRotationStrategy)));
+    return DestinationPtr(new FileDestination(filePath, RotationStrategyPtr(new NullRotationStrategy),
+                                              fallback));
 }
-DestinationPtr DestinationFactory::MakeDailyFileDestination(const QString &filePath, LogRotationOption rotation, const int rotation_hour, const int rotation_minute)
+DestinationPtr DestinationFactory::MakeDailyFileDestination(const QString &filePath, LogRotationOption rotation, const int rotation_hour, const int rotation_minute,
+    DestinationPtr fallback)
 {
     if (EnableLogRotation == rotation) {
         QScopedPointer<DailyRotationStrategy> logRotation(new DailyRotationStrategy);
 
-        return DestinationPtr(new DailyFileDestination(filePath, RotationStrategyPtr(logRotation.take())));
+        return DestinationPtr(new DailyFileDestination(filePath, RotationStrategyPtr(logRotation.take()),
+                                                       fallback));
     }
 
-    return DestinationPtr(new DailyFileDestination(filePath, RotationStrategyPtr(new NullRotationStrategy)));
+    return DestinationPtr(new DailyFileDestination(filePath, RotationStrategyPtr(new NullRotationStrategy),
+                                                   fallback));
 }
 
 DestinationPtr DestinationFactory::MakeDebugOutputDestination()
@@ -77,4 +201,11 @@ DestinationPtr DestinationFactory::MakeFunctorDestination(QObject *receiver, con
     return DestinationPtr(new FunctorDestination(receiver, member));
 }
 
+DestinationPtr DestinationFactory::MakeRateLimitedDestination(DestinationPtr destination,
+    const MaxBytesPerSecond &maxRate, Level keepLevel, int sampleEvery)
+{
+    return DestinationPtr(new RateLimitedDestination(destination, maxRate.rate, keepLevel,
+                                                     sampleEvery));
+}
+
 } // end namespace
@@ -28,6 +28,8 @@
 
 #include "QsLogLevel.h"
 #include <QSharedPointer>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QtGlobal>
 class QString;
 class QObject;
@@ -42,6 +44,7 @@ class QObject;
 
 namespace QsLogging
 {
+class DestinationHealth;
 
 class QSLOG_SHARED_OBJECT Destination
 {
@@ -52,9 +55,65 @@ public:
     virtual ~Destination();
     virtual void write(const QString& message, Level level) = 0;
     virtual bool isValid() = 0; // returns whether the destination was created correctly
+    //! Memory held by the destination's own buffers; counts against the logger's memory budget.
+    //! The default is 0, right for destinations that write each message through.
+    virtual qint64 bufferedBytes();
+    //! Called when the logger is idle; should release buffer capacity that isn't needed right now.
+    //! Of the destinations in this library only HistoryDestination holds any.
+    virtual void trimBuffers();
+    //! Writes out anything the destination still buffers. Called at shutdown.
+    virtual void flush();
+    //! Called in a forked child. 'separateFiles' asks file based destinations to continue in a file
+    //! of their own, see Logger::setSeparateFilesAfterFork.
+    virtual void afterFork(bool separateFiles);
+    //! How often a file based destination has rotated its file, for Logger::statistics.
+    //! Logger::statistics calls this and the two below from any thread, while another one writes.
+    virtual qint64 rotationCount();
+    //! The circuit breaker of a destination that has one, for Logger::statistics. 0 otherwise.
+    virtual const DestinationHealth* health() const;
+    //! Messages the destination dropped on purpose, e.g. a rate limiter, for Logger::statistics.
+    virtual qint64 droppedMessages() const;
 };
 typedef QSharedPointer<Destination> DestinationPtr;
 
+//! Circuit breaker for destinations writing to devices that can fail (files, sockets...).
+//! After TripThreshold consecutive failures the breaker trips: writes are skipped cheaply until the
+//! retry time, and every failed retry doubles the delay up to MaxRetryDelayMs. Retries happen on
+//! whichever thread writes to the destination, i.e. the writer thread with QS_LOG_SEPARATE_THREAD.
+class QSLOG_SHARED_OBJECT DestinationHealth
+{
+public:
+    static const int TripThreshold;
+    static const int InitialRetryDelayMs;
+    static const int MaxRetryDelayMs;
+
+    DestinationHealth();
+
+    //! Returns false while tripped and before the retry time. Skipped writes are counted.
+    bool shouldAttempt();
+    //! Returns true when the success closes a tripped breaker.
+    bool recordSuccess();
+    //! Returns true when the failure trips the breaker.
+    bool recordFailure();
+
+    bool isTripped() const;
+    int retryDelayMs() const;
+    int consecutiveFailures() const;
+    qint64 failureCount() const;
+    qint64 skippedCount() const;
+    qint64 tripCount() const;
+
+private:
+    QElapsedTimer mClock;
+    qint64 mRetryAtMs;
+    int mRetryDelayMs;
+    int mConsecutiveFailures;
+    QAtomicInt mTripped;
+    QAtomicInteger<qint64> mFailures;
+    QAtomicInteger<qint64> mSkipped;
+    QAtomicInteger<qint64> mTrips;
+};
+
 
 // a series of "named" paramaters, to make the file destination creation more readable
 enum LogRotationOption
@@ -77,22 +136,38 @@ struct QSLOG_SHARED_OBJECT MaxOldLogCount
     int count;
 };
 
+struct QSLOG_SHARED_OBJECT MaxBytesPerSecond
+{
+    MaxBytesPerSecond() : rate(0) {}
+    explicit MaxBytesPerSecond(qint64 rate_) : rate(rate_) {}
+    qint64 rate;
+};
+
 
 //! Creates logging destinations/sinks. The caller shares ownership of the destinations with the logger.
 //! After being added to a logger, the caller can discard the pointers.
 class QSLOG_SHARED_OBJECT DestinationFactory
 {
 public:
+    // 'fallback' receives the messages that can't be written to the file, e.g. when the disk is full
     static DestinationPtr MakeFileDestination(const QString& filePath,
         LogRotationOption rotation = DisableLogRotation,
         const MaxSizeBytes &sizeInBytesToRotateAfter = MaxSizeBytes(),
-        const MaxOldLogCount &oldLogsToKeep = MaxOldLogCount());
+        const MaxOldLogCount &oldLogsToKeep = MaxOldLogCount(),
+        DestinationPtr fallback = DestinationPtr());
     static DestinationPtr MakeDebugOutputDestination();
     // takes a pointer to a function
     static DestinationPtr MakeFunctorDestination(Destination::LogFunction f);
     // takes a QObject + signal/slot
     static DestinationPtr MakeFunctorDestination(QObject *receiver, const char *member);
-    static DestinationPtr MakeDailyFileDestination(const QString &filePath, LogRotationOption rotation = DisableLogRotation, const int rotation_hour = 0, const int rotation_minute = 0);
+    // wraps another destination, dropping messages below 'keepLevel' while it receives more than
+    // 'maxRate' bytes per second, measured as UTF-8. With sampleEvery > 0 one in every sampleEvery of those is kept.
+    static DestinationPtr MakeRateLimitedDestination(DestinationPtr destination,
+        const MaxBytesPerSecond &maxRate, Level keepLevel = ErrorLevel, int sampleEvery = 0);
+    // with EnableLogRotation the file is named <base>_<year>_<month>_<day>.<suffix> and a new one
+    // is started every day; without it 'filePath' is used as is
+    static DestinationPtr MakeDailyFileDestination(const QString &filePath, LogRotationOption rotation = DisableLogRotation, const int rotation_hour = 0, const int rotation_minute = 0,
+        DestinationPtr fallback = DestinationPtr());
 };
 
 } // end namespace
@@ -24,6 +24,7 @@
 // OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "QsLogDestConsole.h"
+#include "QsLogOutputCapture.h"
 #include <QString>
 #include <QtGlobal>
 
@@ -37,8 +38,20 @@ void QsDebugOutput::output( const QString& message )
 }
 #elif defined(Q_OS_UNIX)
 #include <cstdio>
+#include <unistd.h>
 void QsDebugOutput::output( const QString& message )
 {
+   // while stderr is captured, writing to it would feed the message back into the log
+   const int fd = QsLogging::StandardOutputCapture::originalStderr();
+   if (fd != STDERR_FILENO) {
+       QByteArray line = message.toLocal8Bit();
+       line.append('\n');
+       if (::write(fd, line.constData(), line.size()) < 0) {
+           // nowhere left to report this
+       }
+       return;
+   }
+
    fprintf(stderr, "%s\n", qPrintable(message));
    fflush(stderr);
 }
@@ -33,6 +33,7 @@
 #include <QtDebug>
 #include <QFileInfo>
 #include <QDir>
+#include <QCoreApplication>
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
 namespace Qt {
@@ -42,10 +43,138 @@ static const QTextStreamFunction endl = ::endl;
 
 const int QsLogging::SizeRotationStrategy::MaxBackupCount = 10;
 
+// Returns and clears the error state left by the last write, so the next write starts clean.
+static QFile::FileError TakeWriteError(QFile &file, QTextStream &stream)
+{
+    QFile::FileError error = file.error();
+    if (error == QFile::NoError && stream.status() != QTextStream::Ok)
+        error = QFile::WriteError;
+    stream.resetStatus();
+    file.unsetError();
+    return error;
+}
+
+// Writes the message to the file, which is opened unbuffered. What a failed write managed to put
+// in the file is cut off again: a retry doesn't follow a fragment, and nothing of a message that
+// went to the fallback instead is left behind to be written once the disk has room again. When
+// the disk is full (Qt reports ENOSPC as a resource error) the oldest backups of this log are
+// deleted one by one until the message fits.
+static bool WriteMessage(QFile &file, QTextStream &stream, QsLogging::RotationStrategy &rotation,
+                         const QString &message)
+{
+    const qint64 sizeBefore = file.size();
+    QFile::FileError error;
+    do {
+        stream << message << Qt::endl;
+        stream.flush();
+        error = TakeWriteError(file, stream);
+        if (error != QFile::NoError && file.size() != sizeBefore) {
+            file.resize(sizeBefore);
+            file.seek(sizeBefore);
+            file.unsetError();
+        }
+    } while (error == QFile::ResourceError && rotation.removeOldestBackup());
+    return error == QFile::NoError;
+}
+
+// Splits the path of a daily log at the last dot of its file name: "dir/log.txt" -> "dir/log" and
+// "txt". Dots in the directory, or in a per-process "log.<pid>.txt", stay in the base.
+static void SplitDailyFileName(const QString &fileName, QString &base, QString &suffix)
+{
+    const int separator = qMax(fileName.lastIndexOf(QLatin1Char('/')), fileName.lastIndexOf(QLatin1Char('\\')));
+    const int dot = fileName.lastIndexOf(QLatin1Char('.'));
+    if (dot > separator) {
+        base = fileName.left(dot);
+        suffix = fileName.mid(dot + 1);
+    } else {
+        base = fileName;
+        suffix.clear();
+    }
+}
+
+// Daily logs are named <base>_<year>_<month>_<day>.<suffix>, see calc_filename. Only those are
+// backups of the log, other files matching <base>_*.<suffix> don't belong to it.
+static bool IsDailyLogName(const QString &fileName, const QString &base, const QString &suffix)
+{
+    const QString prefix = base + QLatin1Char('_');
+    const QString ending = QLatin1Char('.') + suffix;
+    if (!fileName.startsWith(prefix) || !fileName.endsWith(ending)
+        || fileName.size() <= prefix.size() + ending.size()) {
+        return false;
+    }
+    const QStringList date = fileName.mid(prefix.size(), fileName.size() - prefix.size() - ending.size())
+        .split(QLatin1Char('_'));
+    if (date.size() != 3)
+        return false;
+    for (int i = 0;i < date.size();++i) {
+        bool isNumber = false;
+        date.at(i).toUInt(&isNumber);
+        if (!isNumber)
+            return false;
+    }
+    return true;
+}
+
+// Messages the file can't take go to the fallback destination, if any. Switching to and away from
+// the fallback is noted there, so the gap in the file can be explained.
+static void WriteToFallback(const QsLogging::DestinationPtr &fallback, bool &usingFallback,
+                            const QFile &file, const QString &message, QsLogging::Level level)
+{
+    if (fallback.isNull())
+        return;
+
+    if (!usingFallback) {
+        usingFallback = true;
+        fallback->write(QString::fromLatin1("QsLog: could not write to %1, logging here until it "
+                                            "is writable again").arg(file.fileName()),
+                        QsLogging::WarnLevel);
+    }
+    fallback->write(message, level);
+}
+
+// Used after fork() when every process should log to a file of its own: log.txt -> log.<pid>.txt
+static QString PerProcessFileName(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    QString fileName = info.completeBaseName() + QString::fromLatin1(".%1").arg(QCoreApplication::applicationPid());
+    if (!info.suffix().isEmpty())
+        fileName += "." + info.suffix();
+    return QDir(info.absolutePath()).filePath(fileName);
+}
+
+static void LeaveFallback(const QsLogging::DestinationPtr &fallback, bool &usingFallback,
+                          const QFile &file)
+{
+    if (!usingFallback)
+        return;
+
+    usingFallback = false;
+    fallback->write(QString::fromLatin1("QsLog: %1 is writable again").arg(file.fileName()),
+                    QsLogging::InfoLevel);
+}
+
+// Updates the breaker and reports only its state changes, instead of every single failure.
+static void RecordWriteResult(QsLogging::DestinationHealth &health, const QFile &file, bool succeeded)
+{
+    if (succeeded) {
+        if (health.recordSuccess())
+            std::cerr << "QsLog: log file " << qPrintable(file.fileName()) << " is writable again\n";
+    } else if (health.recordFailure()) {
+        std::cerr << "QsLog: disabling log file " << qPrintable(file.fileName()) << " after "
+                  << health.consecutiveFailures() << " consecutive failures, retrying in "
+                  << health.retryDelayMs() << " ms\n";
+    }
+}
+
 QsLogging::RotationStrategy::~RotationStrategy()
 {
 }
 
+bool QsLogging::RotationStrategy::removeOldestBackup()
+{
+    return false;
+}
+
 QsLogging::SizeRotationStrategy::SizeRotationStrategy()
     : mCurrentSizeInBytes(0)
     , mMaxSizeInBytes(0)
@@ -112,6 +241,17 @@ void QsLogging::SizeRotationStrategy::rotate()
      }
 }
 
+bool QsLogging::SizeRotationStrategy::removeOldestBackup()
+{
+    const QString logNamePattern = mFileName + QString::fromUtf8(".%1");
+    for (int i = SizeRotationStrategy::MaxBackupCount;i >= 1;--i) {
+        const QString backupFileName = logNamePattern.arg(i);
+        if (QFile::exists(backupFileName))
+            return QFile::remove(backupFileName);
+    }
+    return false;
+}
+
 QIODevice::OpenMode QsLogging::SizeRotationStrategy::recommendedOpenModeFlag()
 {
     return QIODevice::Append;
@@ -130,8 +270,13 @@ void QsLogging::SizeRotationStrategy::setBackupCount(int backups)
 }
 
 
-QsLogging::FileDestination::FileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy)
-    : mRotationStrategy(rotationStrategy)
+QsLogging::FileDestination::FileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy,
+                                            DestinationPtr fallback)
+    : mFilePath(filePath)
+    , mRotationStrategy(rotationStrategy)
+    , mFallback(fallback)
+    , mUsingFallback(false)
+    , mRotations(0)
 {
     mFile.setFileName(filePath);
     QString fileDir = QFileInfo(filePath).absolutePath();
@@ -139,36 +284,100 @@ QsLogging::FileDestination::FileDestination(const QString& filePath, RotationStr
     if(!dir.exists()) {
         dir.mkdir(fileDir);
     }
-    if (!mFile.open(QFile::WriteOnly | QFile::Text | mRotationStrategy->recommendedOpenModeFlag()))
+    if (!openFile()) {
         std::cerr << "QsLog: could not open log file " << qPrintable(filePath);
-    mOutputStream.setDevice(&mFile);
+        mHealth.recordFailure();
+    }
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     mOutputStream.setCodec(QTextCodec::codecForName("UTF-8"));
 #endif
+}
 
+bool QsLogging::FileDestination::openFile()
+{
+    mOutputStream.setDevice(NULL);
+    mFile.close();
+    const bool opened = mFile.open(QFile::WriteOnly | QFile::Text | QFile::Unbuffered
+                                   | mRotationStrategy->recommendedOpenModeFlag());
+    mFile.unsetError();
     mRotationStrategy->setInitialInfo(mFile);
+    mOutputStream.setDevice(&mFile);
+    return opened;
 }
 
-void QsLogging::FileDestination::write(const QString& message, Level)
+void QsLogging::FileDestination::write(const QString& message, Level level)
 {
-    mRotationStrategy->includeMessageInCalculation(message);
-    if (mRotationStrategy->shouldRotate()) {
-        mOutputStream.setDevice(NULL);
-        mFile.close();
-        mRotationStrategy->rotate();
-        if (!mFile.open(QFile::WriteOnly | QFile::Text | mRotationStrategy->recommendedOpenModeFlag()))
-            std::cerr << "QsLog: could not reopen log file " << qPrintable(mFile.fileName());
-        mRotationStrategy->setInitialInfo(mFile);
-        mOutputStream.setDevice(&mFile);
+    if (!mHealth.shouldAttempt()) {
+        WriteToFallback(mFallback, mUsingFallback, mFile, message, level);
+        return;
     }
 
-    mOutputStream << message << Qt::endl;
-    mOutputStream.flush();
+    // a failed open is retried here, on the writing thread, as permitted by the breaker
+    bool written = mFile.isOpen() || openFile();
+    if (written) {
+        mRotationStrategy->includeMessageInCalculation(message);
+        if (mRotationStrategy->shouldRotate()) {
+            mOutputStream.setDevice(NULL);
+            mFile.close();
+            mRotationStrategy->rotate();
+            mRotations.fetchAndAddRelaxed(1);
+            written = openFile();
+        }
+    }
+    written = written && WriteMessage(mFile, mOutputStream, *mRotationStrategy, message);
+
+    RecordWriteResult(mHealth, mFile, written);
+    if (written)
+        LeaveFallback(mFallback, mUsingFallback, mFile);
+    else
+        WriteToFallback(mFallback, mUsingFallback, mFile, message, level);
 }
 
 bool QsLogging::FileDestination::isValid()
 {
-    return mFile.isOpen();
+    return mFile.isOpen() && !mHealth.isTripped();
+}
+
+qint64 QsLogging::FileDestination::bufferedBytes()
+{
+    return mFallback.isNull() ? 0 : mFallback->bufferedBytes();
+}
+
+void QsLogging::FileDestination::trimBuffers()
+{
+    if (!mFallback.isNull())
+        mFallback->trimBuffers();
+}
+
+void QsLogging::FileDestination::flush()
+{
+    mOutputStream.flush();
+    if (!mFallback.isNull())
+        mFallback->flush();
+}
+
+qint64 QsLogging::FileDestination::rotationCount()
+{
+    return mRotations.loadAcquire();
+}
+
+void QsLogging::FileDestination::afterFork(bool separateFiles)
+{
+    if (!mFallback.isNull())
+        mFallback->afterFork(separateFiles);
+    if (!separateFiles)
+        return;
+
+    mOutputStream.setDevice(NULL);
+    mFile.close();
+    mFile.setFileName(PerProcessFileName(mFilePath));
+    if (!openFile())
+        RecordWriteResult(mHealth, mFile, false);
+}
+
+const QsLogging::DestinationHealth* QsLogging::FileDestination::health() const
+{
+    return &mHealth;
 }
 
 QsLogging::DailyRotationStrategy::DailyRotationStrategy():
@@ -203,21 +412,22 @@ bool QsLogging::DailyRotationStrategy::shouldRotate()
 
 void QsLogging::DailyRotationStrategy::rotate()
 {
-
-    QString fileName = getFileName();
-
-    QString fileDir = QFileInfo(fileName).absolutePath();
-    QString filefilter = QFileInfo(fileName).suffix();
-    QDir dir(fileDir);
-    QStringList filename ;
-    filename << "*."+filefilter;//可叠加，可使用通配符筛选
-    QStringList results;
-    results = dir.entryList(filename,QDir::Files | QDir::Readable,QDir::Time);
-    if(results.length()>29) {
-        for(int i=29;i<results.length();i++)
-        {
-            QFile::remove(results.at(i));
-        }
+    // keep the 29 newest daily logs of this destination, other files in the directory (including
+    // the logs of forked children, which have the pid in their base name) are left alone
+    QString basePath;
+    QString suffix;
+    SplitDailyFileName(mFileName, basePath, suffix);
+    const QString base = QFileInfo(basePath).fileName();
+    QDir dir(QFileInfo(getFileName()).absolutePath());
+    QStringList filters;
+    filters << base + "_*." + suffix;
+    const QStringList results = dir.entryList(filters, QDir::Files | QDir::Readable, QDir::Time);
+    int kept = 0;
+    for (int i = 0;i < results.length();++i) {
+        if (!IsDailyLogName(results.at(i), base, suffix))
+            continue;
+        if (++kept > 29)
+            QFile::remove(dir.filePath(results.at(i)));
     }
 }
 
@@ -228,6 +438,26 @@ QString QsLogging::DailyRotationStrategy::getFileName()
     return fileName;
 }
 
+bool QsLogging::DailyRotationStrategy::removeOldestBackup()
+{
+    QString basePath;
+    QString suffix;
+    SplitDailyFileName(mFileName, basePath, suffix);
+    const QString base = QFileInfo(basePath).fileName();
+    const QString currentFileName = QFileInfo(getFileName()).fileName();
+    QDir dir(QFileInfo(getFileName()).absolutePath());
+    QStringList filters;
+    filters << base + "_*." + suffix;
+    const QStringList oldestFirst = dir.entryList(filters, QDir::Files, QDir::Time | QDir::Reversed);
+    for (int i = 0;i < oldestFirst.length();++i) {
+        if (oldestFirst.at(i) != currentFileName
+            && IsDailyLogName(oldestFirst.at(i), base, suffix)) {
+            return QFile::remove(dir.filePath(oldestFirst.at(i)));
+        }
+    }
+    return false;
+}
+
 QIODevice::OpenMode QsLogging::DailyRotationStrategy::recommendedOpenModeFlag()
 {
     return QIODevice::Append;
@@ -245,13 +475,13 @@ void QsLogging::DailyRotationStrategy::setRotation_minute(int newRotation_minute
 
 QString QsLogging::DailyRotationStrategy::calc_filename(const QString fileName, QDateTime dt)
 {
-    QStringList fileNamesplit = fileName.split(".");
-    if(fileNamesplit.length()<2)
-        fileNamesplit.append("");
+    QString base;
+    QString suffix;
+    SplitDailyFileName(fileName, base, suffix);
     int year = dt.date().year();
     int month = dt.date().month();
     int day = dt.date().day();
-    QString retFileName = QString("%1_%2_%3_%4.%5").arg(fileNamesplit.at(0)).arg(year).arg(month).arg(day).arg(fileNamesplit.at(1));
+    QString retFileName = QString("%1_%2_%3_%4.%5").arg(base).arg(year).arg(month).arg(day).arg(suffix);
     return retFileName;
 }
 
@@ -267,12 +497,20 @@ QDateTime QsLogging::DailyRotationStrategy::next_rotation_tp(int rotation_hour,
     return nowdt;
 }
 
-QsLogging::DailyFileDestination::DailyFileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy)
-    : mRotationStrategy_(rotationStrategy)
+QsLogging::DailyFileDestination::DailyFileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy,
+                                                      DestinationPtr fallback)
+    : mFilePath(filePath)
+    , mRotationStrategy_(rotationStrategy)
+    , mFallback(fallback)
+    , mUsingFallback(false)
+    , mRotations(0)
 {
     mRotationStrategy_->setInitialInfo(QFile(filePath));
 
+    // only the daily strategy puts the date in the name, without rotation the path is used as is
     QString fileName = mRotationStrategy_->getFileName();
+    if (fileName.isEmpty())
+        fileName = filePath;
     mFile.setFileName(fileName);
     QString fileDir = QFileInfo(fileName).absolutePath();
     QString filefilter = QFileInfo(fileName).suffix();
@@ -293,34 +531,102 @@ QsLogging::DailyFileDestination::DailyFileDestination(const QString& filePath, R
     //qDebug()<<results;//results里就是获取的所有文件名了
 
 
-    if (!mFile.open(QFile::WriteOnly | QFile::Text))
+    if (!mFile.open(QFile::WriteOnly | QFile::Text | QFile::Unbuffered)) {
         std::cerr << "QsLog: could not open log file " << qPrintable(filePath);
+        mHealth.recordFailure();
+    }
     mOutputStream.setDevice(&mFile);
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     mOutputStream.setCodec(QTextCodec::codecForName("UTF-8"));
 #endif
 }
 
+bool QsLogging::DailyFileDestination::openFile()
+{
+    mOutputStream.setDevice(NULL);
+    mFile.close();
+    const QString fileName = mRotationStrategy_->getFileName();
+    if (!fileName.isEmpty())
+        mFile.setFileName(fileName);
+    const bool opened = mFile.open(QFile::WriteOnly | QFile::Text | QFile::Unbuffered
+                                   | mRotationStrategy_->recommendedOpenModeFlag());
+    mFile.unsetError();
+    mOutputStream.setDevice(&mFile);
+    return opened;
+}
+
 void QsLogging::DailyFileDestination::write(const QString &message, Level level)
 {
+    if (!mHealth.shouldAttempt()) {
+        WriteToFallback(mFallback, mUsingFallback, mFile, message, level);
+        return;
+    }
+
+    bool written = true;
 //    mRotationStrategy->includeMessageInCalculation(message);
     if (mRotationStrategy_->shouldRotate()) {
         mOutputStream.setDevice(NULL);
         mFile.close();
         mRotationStrategy_->rotate();
-        QString fileName = mRotationStrategy_->getFileName();
-        mFile.setFileName(fileName);
-        if (!mFile.open(QFile::WriteOnly | QFile::Text | mRotationStrategy_->recommendedOpenModeFlag()))
-            std::cerr << "QsLog: could not reopen log file " << qPrintable(mFile.fileName());
-//        mRotationStrategy->setInitialInfo(mFile);
-        mOutputStream.setDevice(&mFile);
+        mRotations.fetchAndAddRelaxed(1);
+        written = openFile();
+    } else if (!mFile.isOpen()) {
+        written = openFile();
     }
+    written = written && WriteMessage(mFile, mOutputStream, *mRotationStrategy_, message);
 
-    mOutputStream << message << Qt::endl;
-    mOutputStream.flush();
+    RecordWriteResult(mHealth, mFile, written);
+    if (written)
+        LeaveFallback(mFallback, mUsingFallback, mFile);
+    else
+        WriteToFallback(mFallback, mUsingFallback, mFile, message, level);
 }
 
 bool QsLogging::DailyFileDestination::isValid()
 {
-    return mFile.isOpen();
+    return mFile.isOpen() && !mHealth.isTripped();
+}
+
+qint64 QsLogging::DailyFileDestination::bufferedBytes()
+{
+    return mFallback.isNull() ? 0 : mFallback->bufferedBytes();
+}
+
+void QsLogging::DailyFileDestination::trimBuffers()
+{
+    if (!mFallback.isNull())
+        mFallback->trimBuffers();
+}
+
+void QsLogging::DailyFileDestination::flush()
+{
+    mOutputStream.flush();
+    if (!mFallback.isNull())
+        mFallback->flush();
+}
+
+qint64 QsLogging::DailyFileDestination::rotationCount()
+{
+    return mRotations.loadAcquire();
+}
+
+void QsLogging::DailyFileDestination::afterFork(bool separateFiles)
+{
+    if (!mFallback.isNull())
+        mFallback->afterFork(separateFiles);
+    if (!separateFiles)
+        return;
+
+    const QString fileName = PerProcessFileName(mFilePath);
+    mOutputStream.setDevice(NULL);
+    mFile.close();
+    mRotationStrategy_->setInitialInfo(QFile(fileName));
+    mFile.setFileName(fileName);
+    if (!openFile())
+        RecordWriteResult(mHealth, mFile, false);
+}
+
+const QsLogging::DestinationHealth* QsLogging::DailyFileDestination::health() const
+{
+    return &mHealth;
 }
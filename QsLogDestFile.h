@@ -46,6 +46,9 @@ public:
     virtual void rotate() = 0;
     virtual QString getFileName() = 0;
     virtual QIODevice::OpenMode recommendedOpenModeFlag() = 0;
+    // Deletes the oldest backup owned by this strategy to free disk space. Returns false if there
+    // was nothing to delete.
+    virtual bool removeOldestBackup();
 };
 
 // Never rotates file, overwrites existing file.
@@ -73,6 +76,7 @@ public:
     void rotate() override;
     QString getFileName() override { return "";}
     QIODevice::OpenMode recommendedOpenModeFlag() override;
+    bool removeOldestBackup() override;
 
     void setMaximumSizeInBytes(qint64 size);
     void setBackupCount(int backups);
@@ -93,6 +97,7 @@ public:
     void rotate() override;
     QString getFileName() override;
     QIODevice::OpenMode recommendedOpenModeFlag() override;
+    bool removeOldestBackup() override;
 
     void setRotation_hour(int newRotation_hour);
     void setRotation_minute(int newRotation_minute);
@@ -108,30 +113,60 @@ private:
 };
 typedef QSharedPointer<RotationStrategy> RotationStrategyPtr;
 
-// file message sink
+// File message sink. When the disk is full, the oldest backups of this log are deleted to make
+// room. Messages that still can't be written, or that arrive while the destination is tripped,
+// are sent to the optional fallback destination until the file is writable again.
 class FileDestination : public Destination
 {
 public:
-    FileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy);
+    FileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy,
+                    DestinationPtr fallback = DestinationPtr());
     void write(const QString& message, Level level) override;
     bool isValid() override;
+    qint64 bufferedBytes() override;
+    void trimBuffers() override;
+    void flush() override;
+    void afterFork(bool separateFiles) override;
+    qint64 rotationCount() override;
+    const DestinationHealth* health() const override;
 
 private:
+    bool openFile();
+
+    QString mFilePath;
     QFile mFile;
     QTextStream mOutputStream;
     QSharedPointer<RotationStrategy> mRotationStrategy;
+    DestinationHealth mHealth;
+    DestinationPtr mFallback;
+    bool mUsingFallback;
+    QAtomicInteger<qint64> mRotations;
 };
 class DailyFileDestination : public Destination
 {
 public:
-    DailyFileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy);
+    DailyFileDestination(const QString& filePath, RotationStrategyPtr rotationStrategy,
+                         DestinationPtr fallback = DestinationPtr());
     void write(const QString& message, Level level) override;
     bool isValid() override;
+    qint64 bufferedBytes() override;
+    void trimBuffers() override;
+    void flush() override;
+    void afterFork(bool separateFiles) override;
+    qint64 rotationCount() override;
+    const DestinationHealth* health() const override;
 
 private:
+    bool openFile();
+
+    QString mFilePath;
     QFile mFile;
     QTextStream mOutputStream;
     QSharedPointer<RotationStrategy> mRotationStrategy_;
+    DestinationHealth mHealth;
+    DestinationPtr mFallback;
+    bool mUsingFallback;
+    QAtomicInteger<qint64> mRotations;
 };
 }
 
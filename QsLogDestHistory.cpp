@@ -0,0 +1,73 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include "QsLogDestHistory.h"
+
+QsLogging::HistoryDestination::HistoryDestination(int maxMessages)
+    : mMaxMessages(qMax(maxMessages, 1))
+    , mBytes(0)
+{
+}
+
+void QsLogging::HistoryDestination::write(const QString& message, Level)
+{
+    QMutexLocker lock(&mMutex);
+    if (mMessages.size() == mMaxMessages)
+        mBytes -= mMessages.takeFirst().capacity() * sizeof(QChar);
+    mMessages.append(message);
+    mBytes += message.capacity() * sizeof(QChar);
+}
+
+bool QsLogging::HistoryDestination::isValid()
+{
+    return true;
+}
+
+qint64 QsLogging::HistoryDestination::bufferedBytes()
+{
+    QMutexLocker lock(&mMutex);
+    return mBytes;
+}
+
+// A message is built by appending to it and can hold twice its size until it is squeezed. Squeezing
+// copies a message that is still shared with a record being written elsewhere, which only happens
+// here, when the logger is idle.
+void QsLogging::HistoryDestination::trimBuffers()
+{
+    QMutexLocker lock(&mMutex);
+    mBytes = 0;
+    for (int i = 0;i < mMessages.size();++i) {
+        mMessages[i].squeeze();
+        mBytes += mMessages.at(i).capacity() * sizeof(QChar);
+    }
+}
+
+QStringList QsLogging::HistoryDestination::messages() const
+{
+    QMutexLocker lock(&mMutex);
+    return mMessages;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef QSLOGDESTHISTORY_H
+#define QSLOGDESTHISTORY_H
+
+#include "QsLogDest.h"
+#include <QMutex>
+#include <QStringList>
+
+namespace QsLogging
+{
+
+// Keeps the last 'maxMessages' messages in memory, e.g. to be dumped through the admin socket
+// after something went wrong. Unlike the other destinations it can be read from any thread.
+class QSLOG_SHARED_OBJECT HistoryDestination : public Destination
+{
+public:
+    explicit HistoryDestination(int maxMessages);
+
+    void write(const QString& message, Level level) override;
+    bool isValid() override;
+    //! the capacity of the kept messages
+    qint64 bufferedBytes() override;
+    //! drops the unused capacity of the kept messages
+    void trimBuffers() override;
+
+    //! the kept messages, oldest first
+    QStringList messages() const;
+
+private:
+    mutable QMutex mMutex;
+    QStringList mMessages;
+    int mMaxMessages;
+    qint64 mBytes;
+};
+
+}
+
+#endif // QSLOGDESTHISTORY_H
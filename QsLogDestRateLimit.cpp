@@ -0,0 +1,139 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "QsLogDestRateLimit.h"
+#include <QString>
+
+QsLogging::RateLimitedDestination::RateLimitedDestination(DestinationPtr destination,
+                                                          qint64 bytesPerSecond, Level keepLevel,
+                                                          int sampleEvery)
+    : mDestination(destination)
+    , mBytesPerSecond(bytesPerSecond)
+    , mMilliTokens(bytesPerSecond * 1000)
+    , mLastRefillMs(0)
+    , mKeepLevel(keepLevel)
+    , mSampleEvery(sampleEvery)
+    , mSkippedSinceSample(0)
+    , mDroppedMessages(0)
+    , mDroppedBytes(0)
+{
+    Q_ASSERT(mDestination.data());
+    Q_ASSERT(bytesPerSecond > 0);
+    mClock.start();
+}
+
+void QsLogging::RateLimitedDestination::refill()
+{
+    const qint64 nowMs = mClock.elapsed();
+    const qint64 burst = mBytesPerSecond * 1000;
+    mMilliTokens = qMin(burst, mMilliTokens + (nowMs - mLastRefillMs) * mBytesPerSecond);
+    mLastRefillMs = nowMs;
+}
+
+// the UTF-8 size of the message, counted without converting it
+static qint64 Utf8Size(const QString& message)
+{
+    qint64 size = 0;
+    const QChar* data = message.constData();
+    for (int i = 0, count = message.size();i < count;++i) {
+        const ushort unicode = data[i].unicode();
+        if (unicode < 0x80)
+            size += 1;
+        else if (unicode < 0x800)
+            size += 2;
+        else if (data[i].isHighSurrogate() && i + 1 < count && data[i + 1].isLowSurrogate()) {
+            size += 4;
+            ++i;
+        }
+        else
+            size += 3;
+    }
+    return size;
+}
+
+void QsLogging::RateLimitedDestination::write(const QString& message, Level level)
+{
+    // plus the line terminator
+    const qint64 size = Utf8Size(message) + 1;
+    refill();
+
+    if (level < mKeepLevel && mMilliTokens < size * 1000) {
+        if (mSampleEvery <= 0 || ++mSkippedSinceSample < mSampleEvery) {
+            mDroppedMessages.fetchAndAddRelaxed(1);
+            mDroppedBytes.fetchAndAddRelaxed(size);
+            return;
+        }
+        mSkippedSinceSample = 0;
+    }
+
+    mMilliTokens -= size * 1000;
+    mDestination->write(message, level);
+}
+
+bool QsLogging::RateLimitedDestination::isValid()
+{
+    return mDestination->isValid();
+}
+
+qint64 QsLogging::RateLimitedDestination::bufferedBytes()
+{
+    return mDestination->bufferedBytes();
+}
+
+void QsLogging::RateLimitedDestination::trimBuffers()
+{
+    mDestination->trimBuffers();
+}
+
+void QsLogging::RateLimitedDestination::flush()
+{
+    mDestination->flush();
+}
+
+void QsLogging::RateLimitedDestination::afterFork(bool separateFiles)
+{
+    mDestination->afterFork(separateFiles);
+}
+
+qint64 QsLogging::RateLimitedDestination::rotationCount()
+{
+    return mDestination->rotationCount();
+}
+
+const QsLogging::DestinationHealth* QsLogging::RateLimitedDestination::health() const
+{
+    return mDestination->health();
+}
+
+qint64 QsLogging::RateLimitedDestination::droppedMessages() const
+{
+    return mDroppedMessages.loadAcquire();
+}
+
+qint64 QsLogging::RateLimitedDestination::droppedBytes() const
+{
+    return mDroppedBytes.loadAcquire();
+}
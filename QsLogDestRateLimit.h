@@ -0,0 +1,78 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef QSLOGDESTRATELIMIT_H
+#define QSLOGDESTRATELIMIT_H
+
+#include "QsLogDest.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+namespace QsLogging
+{
+
+// Caps the bytes per second reaching another destination using a token bucket that holds up to one
+// second worth of bytes. A message counts as its UTF-8 size plus a line terminator, which is what
+// the file destinations write. While the bucket is empty, messages below the keep level are dropped
+// (or, if sampling is enabled, only one in every 'sampleEvery' is let through). Messages at or
+// above the keep level are never held back; they are written immediately and charged to the
+// bucket, which may leave it in debt.
+class QSLOG_SHARED_OBJECT RateLimitedDestination : public Destination
+{
+public:
+    RateLimitedDestination(DestinationPtr destination, qint64 bytesPerSecond, Level keepLevel,
+                           int sampleEvery);
+
+    void write(const QString& message, Level level) override;
+    bool isValid() override;
+    qint64 bufferedBytes() override;
+    void trimBuffers() override;
+    void flush() override;
+    void afterFork(bool separateFiles) override;
+    qint64 rotationCount() override;
+    const DestinationHealth* health() const override;
+
+    qint64 droppedMessages() const override;
+    qint64 droppedBytes() const;
+
+private:
+    void refill();
+
+    DestinationPtr mDestination;
+    QElapsedTimer mClock;
+    qint64 mBytesPerSecond;
+    qint64 mMilliTokens; // bytes * 1000, so slow rates still refill on every millisecond
+    qint64 mLastRefillMs;
+    Level mKeepLevel;
+    int mSampleEvery;
+    int mSkippedSinceSample;
+    QAtomicInteger<qint64> mDroppedMessages;
+    QAtomicInteger<qint64> mDroppedBytes;
+};
+
+}
+
+#endif // QSLOGDESTRATELIMIT_H
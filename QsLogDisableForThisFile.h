@@ -11,6 +11,16 @@
 #undef QLOG_WARN
 #undef QLOG_ERROR
 #undef QLOG_FATAL
+#undef QLOG_TRACE_TO
+#undef QLOG_DEBUG_TO
+#undef QLOG_INFO_TO
+#undef QLOG_WARN_TO
+#undef QLOG_ERROR_TO
+#undef QLOG_FATAL_TO
+#undef QLOG_AT
+#undef QLOG_AT_TO
+#undef QLOG_MEASURE
+#undef QLOG_MEASURE_TO
 
 #define QLOG_TRACE() if (1) {} else qDebug()
 #define QLOG_DEBUG() if (1) {} else qDebug()
@@ -18,5 +28,15 @@
 #define QLOG_WARN()  if (1) {} else qDebug()
 #define QLOG_ERROR() if (1) {} else qDebug()
 #define QLOG_FATAL() if (1) {} else qDebug()
+#define QLOG_TRACE_TO(logger) if (1) {} else qDebug()
+#define QLOG_DEBUG_TO(logger) if (1) {} else qDebug()
+#define QLOG_INFO_TO(logger)  if (1) {} else qDebug()
+#define QLOG_WARN_TO(logger)  if (1) {} else qDebug()
+#define QLOG_ERROR_TO(logger) if (1) {} else qDebug()
+#define QLOG_FATAL_TO(logger) if (1) {} else qDebug()
+#define QLOG_AT(level) if (1) {} else qDebug()
+#define QLOG_AT_TO(logger, level) if (1) {} else qDebug()
+#define QLOG_MEASURE(level, value) if (1) {} else qDebug()
+#define QLOG_MEASURE_TO(logger, level, value) if (1) {} else qDebug()
 
 #endif // QSLOGDISABLEFORTHISFILE_H
@@ -0,0 +1,55 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef QSLOGFORKLOCKS_H
+#define QSLOGFORKLOCKS_H
+
+class QMutex;
+
+namespace QsLogging
+{
+
+// The process wide mutexes of the other modules, locked by the fork handlers in QsLog.cpp so that
+// no other thread holds one of them while fork() copies the process. The order is fixed: the
+// admin socket and output capture mutexes are held while their threads log, so they come before
+// the loggers' mutexes; the signal safe and call site mutexes can be taken while a logger writes,
+// so they come after them. The first two only exist on Unix, like the fork handlers.
+QMutex& AdminSocketMutex();
+QMutex& OutputCaptureMutex();
+QMutex& SignalSafeMutex();
+QMutex& CallSiteMutex();
+
+// Called in a forked child with AdminSocketMutex() held: forgets the parent's admin server
+// without waiting for its thread, which doesn't exist in the child, or removing its socket.
+void AdminSocketAfterFork();
+// Called in a forked child with OutputCaptureMutex() held: ends the capture in the child without
+// waiting for the reader thread.
+void OutputCaptureAfterFork();
+
+}
+
+#endif // QSLOGFORKLOCKS_H
@@ -37,9 +37,21 @@ enum Level
     WarnLevel,
     ErrorLevel,
     FatalLevel,
-    OffLevel
+    OffLevel,
+    //! Custom severities, see Logger::registerLevel. Wherever levels are compared they rank
+    //! above FatalLevel.
+    FirstCustomLevel,
+    LastCustomLevel = 31
 };
 
+//! A set of levels, bit N stands for the level with value N.
+typedef unsigned int LevelMask;
+
+inline LevelMask levelBit(Level level)
+{
+    return 1u << level;
+}
+
 }
 
 #endif // QSLOGLEVEL_H
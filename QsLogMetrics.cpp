@@ -0,0 +1,191 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "QsLogMetrics.h"
+#include "QsLogCallSite.h"
+#include <QSaveFile>
+
+namespace QsLogging
+{
+
+// label values escape backslashes, quotes and line breaks
+static QString LabelValue(const QString& value)
+{
+    QString escaped = value;
+    escaped.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    escaped.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    escaped.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+    return escaped;
+}
+
+static void AppendType(QString& text, const char* name, const char* type, const char* help)
+{
+    text.append(QString::fromLatin1("# TYPE %1 %2\n# HELP %1 %3\n")
+                .arg(QLatin1String(name), QLatin1String(type), QLatin1String(help)));
+}
+
+static void AppendSample(QString& text, const QString& name, const QString& labels, qint64 value)
+{
+    text.append(name);
+    if (!labels.isEmpty())
+        text.append(QLatin1Char('{')).append(labels).append(QLatin1Char('}'));
+    text.append(QLatin1Char(' ')).append(QString::number(value)).append(QLatin1Char('\n'));
+}
+
+// the buckets are cumulative in OpenMetrics; 'bound' gives the upper bound of bucket i
+static void AppendHistogram(QString& text, const QString& name, const QString& labels,
+                            const QVector<qint64>& buckets, const QString& sum,
+                            QString (*bound)(int))
+{
+    const QString prefix = labels.isEmpty() ? QString() : labels + QLatin1Char(',');
+    qint64 count = 0;
+    for (int i = 0;i < buckets.size();++i) {
+        count += buckets.at(i);
+        const QString le = i == buckets.size() - 1 ? QString::fromLatin1("+Inf") : bound(i);
+        AppendSample(text, name + QLatin1String("_bucket"),
+                     prefix + QString::fromLatin1("le=\"%1\"").arg(le), count);
+    }
+    AppendSample(text, name + QLatin1String("_count"), labels, count);
+    text.append(name).append(QLatin1String("_sum"));
+    if (!labels.isEmpty())
+        text.append(QLatin1Char('{')).append(labels).append(QLatin1Char('}'));
+    text.append(QLatin1Char(' ')).append(sum).append(QLatin1Char('\n'));
+}
+
+static QString MicrosecondBound(int bucket)
+{
+    return QString::number((Q_INT64_C(1) << bucket) / 1e6, 'g', 12);
+}
+
+static QString PowerOfTwoBound(int bucket)
+{
+    return QString::number(Q_INT64_C(1) << bucket);
+}
+
+QString OpenMetricsExport::text(const LoggerStatistics& statistics)
+{
+    QString text;
+    AppendType(text, "qslog_records", "counter", "Records written per level.");
+    for (int i = 0;i < statistics.records.size();++i) {
+        AppendSample(text, QLatin1String("qslog_records_total"),
+                     QString::fromLatin1("level=\"%1\"").arg(LabelValue(statistics.levelNames.at(i))),
+                     statistics.records.at(i));
+    }
+
+    AppendType(text, "qslog_destination_written", "counter",
+               "Characters written per destination, in the order the destinations were added.");
+    for (int i = 0;i < statistics.destinationBytes.size();++i) {
+        AppendSample(text, QLatin1String("qslog_destination_written_total"),
+                     QString::fromLatin1("destination=\"%1\"").arg(i),
+                     statistics.destinationBytes.at(i));
+    }
+    AppendType(text, "qslog_destination_rotations", "counter", "Log file rotations per destination.");
+    for (int i = 0;i < statistics.destinationRotations.size();++i) {
+        AppendSample(text, QLatin1String("qslog_destination_rotations_total"),
+                     QString::fromLatin1("destination=\"%1\"").arg(i),
+                     statistics.destinationRotations.at(i));
+    }
+
+    AppendType(text, "qslog_destination_breaker_open", "gauge",
+               "1 while the destination's circuit breaker is tripped.");
+    for (int i = 0;i < statistics.destinationBreakerOpen.size();++i) {
+        AppendSample(text, QLatin1String("qslog_destination_breaker_open"),
+                     QString::fromLatin1("destination=\"%1\"").arg(i),
+                     statistics.destinationBreakerOpen.at(i) ? 1 : 0);
+    }
+    AppendType(text, "qslog_destination_breaker_trips", "counter",
+               "Times the destination's circuit breaker tripped.");
+    for (int i = 0;i < statistics.destinationBreakerTrips.size();++i) {
+        AppendSample(text, QLatin1String("qslog_destination_breaker_trips_total"),
+                     QString::fromLatin1("destination=\"%1\"").arg(i),
+                     statistics.destinationBreakerTrips.at(i));
+    }
+    AppendType(text, "qslog_destination_skipped_records", "counter",
+               "Records not written to the destination while its circuit breaker was tripped.");
+    for (int i = 0;i < statistics.destinationSkippedRecords.size();++i) {
+        AppendSample(text, QLatin1String("qslog_destination_skipped_records_total"),
+                     QString::fromLatin1("destination=\"%1\"").arg(i),
+                     statistics.destinationSkippedRecords.at(i));
+    }
+    AppendType(text, "qslog_destination_dropped_messages", "counter",
+               "Messages the destination's rate limiter dropped.");
+    for (int i = 0;i < statistics.destinationDroppedMessages.size();++i) {
+        AppendSample(text, QLatin1String("qslog_destination_dropped_messages_total"),
+                     QString::fromLatin1("destination=\"%1\"").arg(i),
+                     statistics.destinationDroppedMessages.at(i));
+    }
+
+    AppendType(text, "qslog_dropped_records", "counter",
+               "Records dropped by the memory budget or a writer stall.");
+    AppendSample(text, QLatin1String("qslog_dropped_records_total"), QString(),
+                 statistics.droppedRecords);
+    AppendType(text, "qslog_queue_depth", "gauge", "Records waiting for the writer thread.");
+    AppendSample(text, QLatin1String("qslog_queue_depth"), QString(), statistics.queueDepth);
+    AppendType(text, "qslog_writer_stalls", "counter", "Stalls detected by the writer watchdog.");
+    AppendSample(text, QLatin1String("qslog_writer_stalls_total"), QString(), statistics.writerStalls);
+    AppendType(text, "qslog_writer_stalled", "gauge", "1 while the writer thread is stalled.");
+    AppendSample(text, QLatin1String("qslog_writer_stalled"), QString(),
+                 statistics.stalledDestination >= 0 ? 1 : 0);
+
+    AppendType(text, "qslog_write_latency_seconds", "histogram",
+               "Time taken to write a record to all destinations.");
+    AppendHistogram(text, QLatin1String("qslog_write_latency_seconds"), QString(),
+                    statistics.writeLatencyBuckets,
+                    QString::number(statistics.writeLatencySumNs / 1e9, 'g', 12), MicrosecondBound);
+
+    const QList<CallSiteInfo> metrics = CallSiteRegistry::metrics();
+    AppendType(text, "qslog_call_site", "counter", "Records of Counted and Measured statements.");
+    for (int i = 0;i < metrics.size();++i) {
+        const CallSiteInfo& site = metrics.at(i);
+        AppendSample(text, QLatin1String("qslog_call_site_total"),
+                     QString::fromLatin1("site=\"%1:%2\"").arg(LabelValue(site.file)).arg(site.line),
+                     site.records);
+    }
+    AppendType(text, "qslog_call_site_value", "histogram",
+               "The values recorded by Measured statements.");
+    for (int i = 0;i < metrics.size();++i) {
+        const CallSiteInfo& site = metrics.at(i);
+        if (site.buckets.isEmpty())
+            continue;
+        AppendHistogram(text, QLatin1String("qslog_call_site_value"),
+                        QString::fromLatin1("site=\"%1:%2\"").arg(LabelValue(site.file)).arg(site.line),
+                        site.buckets, QString::number(site.sum), PowerOfTwoBound);
+    }
+
+    text.append(QLatin1String("# EOF\n"));
+    return text;
+}
+
+bool OpenMetricsExport::writeFile(const QString& filePath, const QString& text)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(text.toUtf8());
+    return file.commit();
+}
+
+}
@@ -0,0 +1,341 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "QsLogOutputCapture.h"
+#include "QsLog.h"
+#include "QsLogForkLocks.h"
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+#include <QThread>
+#include <QtGlobal>
+#include <cstdio>
+
+#if defined(Q_OS_UNIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace QsLogging
+{
+
+// how often the reader checks whether it should stop
+static const int PollIntervalMs = 100;
+// a line that grows past this is logged in pieces
+static const int MaxLineBytes = 64 * 1024;
+// requested pipe size where it can be changed, gives the reader some slack before writers block
+static const int PipeBufferBytes = 1024 * 1024;
+
+struct CapturedStream
+{
+    CapturedStream() : fd(-1), savedFd(-1), readFd(-1), level(InfoLevel) {}
+
+    int fd;      // 1 or 2
+    int savedFd; // what fd pointed to before the capture
+    int readFd;  // read end of the pipe that fd now points to
+    Level level;
+    QString category;
+    QByteArray pending; // incomplete last line
+};
+
+class CaptureReader : public QThread
+{
+public:
+    CaptureReader(Logger& logger, const QVector<CapturedStream>& streams);
+
+    void requestStop();
+    QVector<CapturedStream>& streams() { return mStreams; }
+
+protected:
+    void run() override;
+
+private:
+    bool readAvailable(CapturedStream& stream);
+    void logLines(CapturedStream& stream, bool flushPartialLine);
+
+    Logger& mLogger;
+    QVector<CapturedStream> mStreams;
+    QAtomicInt mStopRequested;
+};
+
+static QMutex sCaptureMutex;
+static CaptureReader* sReader = 0;
+
+QMutex& OutputCaptureMutex()
+{
+    return sCaptureMutex;
+}
+
+// A duplicate of stderr that is never closed, so DebugOutputDestination can keep writing to it
+// while the capture stops on another thread. It is refreshed with dup2 on every start.
+static int sStderrCopy = -1;
+static QAtomicInt sOriginalStderr(STDERR_FILENO);
+
+CaptureReader::CaptureReader(Logger& logger, const QVector<CapturedStream>& streams)
+    : mLogger(logger)
+    , mStreams(streams)
+    , mStopRequested(0)
+{
+}
+
+void CaptureReader::requestStop()
+{
+    mStopRequested.storeRelease(1);
+}
+
+void CaptureReader::run()
+{
+    pollfd fds[2];
+    Q_ASSERT(mStreams.size() <= 2);
+    while (!mStopRequested.loadAcquire()) {
+        for (int i = 0;i < mStreams.size();++i) {
+            fds[i].fd = mStreams[i].readFd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if (poll(fds, mStreams.size(), PollIntervalMs) <= 0)
+            continue;
+        for (int i = 0;i < mStreams.size();++i) {
+            if (fds[i].revents & (POLLIN | POLLHUP))
+                readAvailable(mStreams[i]);
+        }
+    }
+
+    // the streams have been restored by now, pick up what is left in the pipes
+    for (int i = 0;i < mStreams.size();++i) {
+        while (readAvailable(mStreams[i])) {
+        }
+        logLines(mStreams[i], true);
+    }
+}
+
+// Reads what the non-blocking pipe holds right now. Returns false once it is empty or closed.
+bool CaptureReader::readAvailable(CapturedStream& stream)
+{
+    char buffer[4096];
+    const ssize_t count = ::read(stream.readFd, buffer, sizeof(buffer));
+    if (count <= 0)
+        return count < 0 && errno == EINTR;
+
+    stream.pending.append(buffer, static_cast<int>(count));
+    logLines(stream, false);
+    return true;
+}
+
+void CaptureReader::logLines(CapturedStream& stream, bool flushPartialLine)
+{
+    int start = 0;
+    for (;;) {
+        int end = stream.pending.indexOf('\n', start);
+        if (end < 0) {
+            const bool tooLong = stream.pending.size() - start >= MaxLineBytes;
+            if (!(flushPartialLine || tooLong) || start == stream.pending.size())
+                break;
+            end = stream.pending.size();
+        }
+
+        int lineEnd = end;
+        if (lineEnd > start && stream.pending.at(lineEnd - 1) == '\r')
+            --lineEnd;
+        QString text = QString::fromLocal8Bit(stream.pending.constData() + start, lineEnd - start);
+        if (!stream.category.isEmpty())
+            text.prepend(stream.category + QLatin1String(": "));
+        mLogger.logText(stream.level, text);
+        start = qMin(end + 1, static_cast<int>(stream.pending.size()));
+    }
+    stream.pending.remove(0, start);
+}
+
+static void RestoreStream(CapturedStream& stream)
+{
+    if (stream.savedFd >= 0) {
+        ::dup2(stream.savedFd, stream.fd);
+        ::close(stream.savedFd);
+        stream.savedFd = -1;
+    }
+}
+
+static bool RedirectStream(CapturedStream& stream)
+{
+    int fds[2];
+    if (::pipe(fds) != 0)
+        return false;
+
+    stream.savedFd = ::dup(stream.fd);
+    if (stream.savedFd < 0) {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return false;
+    }
+    ::fcntl(stream.savedFd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+#ifdef F_SETPIPE_SZ
+    ::fcntl(fds[1], F_SETPIPE_SZ, PipeBufferBytes);
+#endif
+
+    const bool redirected = ::dup2(fds[1], stream.fd) >= 0;
+    ::close(fds[1]);
+    stream.readFd = fds[0];
+    if (!redirected) {
+        ::close(stream.savedFd);
+        stream.savedFd = -1;
+    }
+    return redirected;
+}
+
+bool StandardOutputCapture::start(Logger& logger, const OutputCaptureOptions& options)
+{
+    QMutexLocker lock(&sCaptureMutex);
+    if (sReader)
+        return false;
+
+    QVector<CapturedStream> streams;
+    if (options.captureStdout) {
+        CapturedStream out;
+        out.fd = STDOUT_FILENO;
+        out.level = options.stdoutLevel;
+        out.category = options.stdoutCategory;
+        streams.push_back(out);
+    }
+    if (options.captureStderr) {
+        CapturedStream err;
+        err.fd = STDERR_FILENO;
+        err.level = options.stderrLevel;
+        err.category = options.stderrCategory;
+        streams.push_back(err);
+    }
+    if (streams.isEmpty())
+        return false;
+
+    fflush(stdout);
+    fflush(stderr);
+    if (options.captureStderr) {
+        if (sStderrCopy < 0)
+            sStderrCopy = ::fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+#if defined(Q_OS_LINUX)
+        else
+            ::dup3(STDERR_FILENO, sStderrCopy, O_CLOEXEC);
+#else
+        // dup2 clears close-on-exec on the target
+        else if (::dup2(STDERR_FILENO, sStderrCopy) >= 0)
+            ::fcntl(sStderrCopy, F_SETFD, FD_CLOEXEC);
+#endif
+    }
+
+    for (int i = 0;i < streams.size();++i) {
+        if (!RedirectStream(streams[i])) {
+            for (int j = 0;j <= i;++j) {
+                RestoreStream(streams[j]);
+                if (streams[j].readFd >= 0)
+                    ::close(streams[j].readFd);
+            }
+            return false;
+        }
+    }
+    if (options.captureStderr && sStderrCopy >= 0)
+        sOriginalStderr.storeRelease(sStderrCopy);
+
+    sReader = new CaptureReader(logger, streams);
+    sReader->start();
+    return true;
+}
+
+void StandardOutputCapture::stop()
+{
+    QMutexLocker lock(&sCaptureMutex);
+    if (!sReader)
+        return;
+
+    fflush(stdout);
+    fflush(stderr);
+    // once the streams point back to their targets the pipes get no more data, the reader drains
+    // them and exits
+    QVector<CapturedStream>& streams = sReader->streams();
+    for (int i = 0;i < streams.size();++i)
+        RestoreStream(streams[i]);
+    sOriginalStderr.storeRelease(STDERR_FILENO);
+
+    sReader->requestStop();
+    sReader->wait();
+    for (int i = 0;i < streams.size();++i)
+        ::close(streams[i].readFd);
+    delete sReader;
+    sReader = 0;
+}
+
+// The reader thread doesn't exist in a forked child. The child's streams are pointed back at their
+// targets, so that the parent's reader doesn't log what the child writes, and the reader object is
+// left behind: it can't be deleted while it believes its thread runs.
+void OutputCaptureAfterFork()
+{
+    if (!sReader)
+        return;
+    QVector<CapturedStream>& streams = sReader->streams();
+    for (int i = 0;i < streams.size();++i) {
+        RestoreStream(streams[i]);
+        ::close(streams[i].readFd);
+    }
+    sOriginalStderr.storeRelease(STDERR_FILENO);
+    sReader = 0;
+}
+
+bool StandardOutputCapture::isActive()
+{
+    QMutexLocker lock(&sCaptureMutex);
+    return sReader != 0;
+}
+
+int StandardOutputCapture::originalStderr()
+{
+    return sOriginalStderr.loadAcquire();
+}
+
+} // end namespace
+
+#else
+
+bool QsLogging::StandardOutputCapture::start(Logger&, const OutputCaptureOptions&)
+{
+    return false;
+}
+
+void QsLogging::StandardOutputCapture::stop()
+{
+}
+
+bool QsLogging::StandardOutputCapture::isActive()
+{
+    return false;
+}
+
+int QsLogging::StandardOutputCapture::originalStderr()
+{
+    return 2;
+}
+
+#endif
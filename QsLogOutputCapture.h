@@ -0,0 +1,81 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef QSLOGOUTPUTCAPTURE_H
+#define QSLOGOUTPUTCAPTURE_H
+
+#include "QsLogLevel.h"
+#include "QsLogDest.h"
+#include <QString>
+
+namespace QsLogging
+{
+class Logger;
+
+//! Which standard streams are captured and how their lines are tagged.
+struct QSLOG_SHARED_OBJECT OutputCaptureOptions
+{
+    OutputCaptureOptions()
+        : captureStdout(true)
+        , captureStderr(true)
+        , stdoutLevel(InfoLevel)
+        , stderrLevel(WarnLevel)
+        , stdoutCategory(QLatin1String("stdout"))
+        , stderrCategory(QLatin1String("stderr"))
+    {}
+
+    bool captureStdout;
+    bool captureStderr;
+    Level stdoutLevel;
+    Level stderrLevel;
+    //! prepended to every captured line as "category: ", nothing is prepended when empty
+    QString stdoutCategory;
+    QString stderrCategory;
+};
+
+//! Redirects file descriptors 1 and 2 into pipes so that whatever is written there, e.g. by native
+//! libraries, is logged line by line. A background thread reads the pipes and hands the lines to
+//! the logger, which queues them when QS_LOG_SEPARATE_THREAD is defined; writers only block if
+//! they outrun the pipe buffer. Note that stdio buffers output written to a pipe, so a library's
+//! printf output may arrive late unless it flushes.
+//! DebugOutputDestination keeps writing to the original stderr while it is captured.
+//! Only implemented on Unix, start() returns false elsewhere. Process wide: there is at most
+//! one capture at a time and it must be stopped before its logger is destroyed. A forked child
+//! is not captured, its streams point to where they did before the capture.
+class QSLOG_SHARED_OBJECT StandardOutputCapture
+{
+public:
+    static bool start(Logger& logger, const OutputCaptureOptions& options = OutputCaptureOptions());
+    //! Restores the streams and logs what was still buffered in the pipes.
+    static void stop();
+    static bool isActive();
+    //! The descriptor stderr pointed to before it was captured, or 2 when it isn't captured.
+    static int originalStderr();
+};
+
+}
+
+#endif // QSLOGOUTPUTCAPTURE_H
@@ -0,0 +1,53 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef QSLOGSHAREDLEVELS_H
+#define QSLOGSHAREDLEVELS_H
+
+#include "QsLogLevel.h"
+#include <QAtomicInteger>
+
+namespace QsLogging
+{
+
+//! The shared memory page created by Logger::shareLevels, as seen by the logger and by
+//! tools/qslogctl. Both sides only ever touch 'levels' with atomic operations.
+struct SharedLevelPage
+{
+    enum { Magic = 0x51534c47, Version = 1 }; // "QSLG"
+
+    SharedLevelPage() : magic(Magic), version(Version), levels(0) {}
+
+    quint32 magic;
+    quint32 version;
+    //! the levels the logging macros let through, one levelBit() per level
+    QAtomicInteger<LevelMask> levels;
+};
+
+}
+
+#endif // QSLOGSHAREDLEVELS_H
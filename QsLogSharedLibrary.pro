@@ -19,7 +19,9 @@ win32 {
 
 unix:!macx {
     # make install will install the shared object in the appropriate folders
-    headers.files = QsLog.h QsLogDest.h QsLogLevel.h
+    # every header from QsLog.pri is installed, so QsLog.h never includes one that is missing
+    headers.files = $$HEADERS
+    headers.files -= $$PWD/QsLogForkLocks.h # internal to the library
     headers.path = /usr/include/$(QMAKE_TARGET)
 
     other_files.files = *.txt
@@ -0,0 +1,163 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include "QsLogSignalSafe.h"
+#include "QsLog.h"
+#include "QsLogForkLocks.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <ctime>
+
+namespace QsLogging
+{
+
+// The buffer is a bounded queue of sequenced slots: a slot is free for position p when its
+// sequence is p, and holds the record for position p once its sequence is p + 1. Producers claim
+// positions with a compare-and-swap, the writer is the only consumer.
+struct SignalSafeSlot
+{
+    QAtomicInteger<quintptr> sequence;
+    SignalSafeRecord record;
+};
+
+static SignalSafeSlot* sSlots = 0;
+static quintptr sMask = 0;
+// next position to claim
+static QAtomicInteger<quintptr> sHead;
+// next position to take, only touched by the target's writer
+static quintptr sTail = 0;
+static QAtomicInteger<qint64> sDropped;
+// set last by initialize(), publishes sSlots and sMask to the handlers
+static QAtomicPointer<LoggerImpl> sTarget;
+
+static QMutex& InitializeMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QMutex& SignalSafeMutex()
+{
+    return InitializeMutex();
+}
+
+// clock_gettime is async-signal-safe, QDateTime isn't
+static qint64 CurrentMSecsSinceEpoch()
+{
+#if defined(Q_OS_UNIX)
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return qint64(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+#else
+    return qint64(std::time(0)) * 1000;
+#endif
+}
+
+bool SignalSafeLog::initialize(Logger& logger, int capacity)
+{
+    QMutexLocker lock(&InitializeMutex());
+    if (sTarget.loadAcquire())
+        return false;
+
+    // a handler may still be writing to the buffer of a detached logger, it is kept
+    if (!sSlots) {
+        quintptr size = 1;
+        while (size < quintptr(qMax(capacity, 1)))
+            size <<= 1;
+        sSlots = new SignalSafeSlot[size];
+        for (quintptr i = 0;i < size;++i)
+            sSlots[i].sequence.storeRelease(i);
+        sMask = size - 1;
+    }
+    sTarget.storeRelease(logger.d);
+    return true;
+}
+
+qint64 SignalSafeLog::droppedRecords()
+{
+    return sDropped.loadAcquire();
+}
+
+bool SignalSafeLog::append(Level level, const char* message, int valueCount,
+                           qint64 value1, qint64 value2, qint64 value3, qint64 value4)
+{
+    if (!sTarget.loadAcquire()) {
+        sDropped.fetchAndAddOrdered(1);
+        return false;
+    }
+
+    quintptr position = sHead.loadAcquire();
+    for (;;) {
+        SignalSafeSlot& slot = sSlots[position & sMask];
+        const qintptr lag = qintptr(slot.sequence.loadAcquire() - position);
+        if (lag < 0) {
+            // the slot still holds the record from the previous lap
+            sDropped.fetchAndAddOrdered(1);
+            return false;
+        }
+        if (lag == 0 && sHead.testAndSetOrdered(position, position + 1)) {
+            SignalSafeRecord& record = slot.record;
+            record.level = level;
+            record.timestampMs = CurrentMSecsSinceEpoch();
+            record.message = message;
+            record.valueCount = valueCount;
+            record.values[0] = value1;
+            record.values[1] = value2;
+            record.values[2] = value3;
+            record.values[3] = value4;
+            slot.sequence.storeRelease(position + 1);
+            return true;
+        }
+        // another producer, possibly the code this handler interrupted, got there first
+        position = sHead.loadAcquire();
+    }
+}
+
+LoggerImpl* SignalSafeLog::target()
+{
+    return sTarget.loadAcquire();
+}
+
+void SignalSafeLog::detach(LoggerImpl* logger)
+{
+    QMutexLocker lock(&InitializeMutex());
+    sTarget.testAndSetOrdered(logger, 0);
+}
+
+bool SignalSafeLog::take(SignalSafeRecord* record)
+{
+    SignalSafeSlot& slot = sSlots[sTail & sMask];
+    if (slot.sequence.loadAcquire() != sTail + 1)
+        return false;
+    *record = slot.record;
+    slot.sequence.storeRelease(sTail + sMask + 1);
+    ++sTail;
+    return true;
+}
+
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef QSLOGSIGNALSAFE_H
+#define QSLOGSIGNALSAFE_H
+
+#include "QsLogDest.h"
+#include "QsLogLevel.h"
+#include <QtGlobal>
+
+namespace QsLogging
+{
+class Logger;
+class LoggerImpl;
+
+//! A record logged by SignalSafeLog, kept as raw values until the writer formats it.
+struct SignalSafeRecord
+{
+    enum { MaxValues = 4 };
+
+    Level level;
+    qint64 timestampMs;   //!< milliseconds since the epoch
+    const char* message;
+    int valueCount;
+    qint64 values[MaxValues];
+};
+
+//! The only part of QsLog that may be used from a signal handler. Records are copied into a
+//! buffer allocated by initialize() without locks, memory allocation or formatting; the
+//! logger's writer turns them into "message value1 value2..." lines the next time it writes a
+//! message, is flushed or shut down. Nothing wakes the writer for them, so a process that may
+//! log nothing else for a while should call Logger::flush() periodically, e.g. from a timer.
+//! Messages must be string literals or otherwise outlive the logger, they are read on the
+//! writer long after the handler returned.
+class QSLOG_SHARED_OBJECT SignalSafeLog
+{
+public:
+    //! Allocates room for 'capacity' records (rounded up to a power of two) which are written
+    //! through 'logger'. Call it once, before installing the signal handlers; the buffer is never
+    //! freed since a handler may run at any time. Shutting the logger down detaches it: later
+    //! records are dropped until initialize() is called again with another logger, which reuses
+    //! the buffer and its capacity. Returns false if a logger is attached.
+    static bool initialize(Logger& logger, int capacity = 256);
+
+    //! Async-signal-safe. Returns false, and counts the record as dropped, when the buffer is
+    //! full or was not initialized. The logger's level is applied when the record is written.
+    static bool write(Level level, const char* message)
+    { return append(level, message, 0, 0, 0, 0, 0); }
+    static bool write(Level level, const char* message, qint64 value1)
+    { return append(level, message, 1, value1, 0, 0, 0); }
+    static bool write(Level level, const char* message, qint64 value1, qint64 value2)
+    { return append(level, message, 2, value1, value2, 0, 0); }
+    static bool write(Level level, const char* message, qint64 value1, qint64 value2,
+                      qint64 value3)
+    { return append(level, message, 3, value1, value2, value3, 0); }
+    static bool write(Level level, const char* message, qint64 value1, qint64 value2,
+                      qint64 value3, qint64 value4)
+    { return append(level, message, 4, value1, value2, value3, value4); }
+
+    //! Records lost because the buffer was full or not initialized.
+    static qint64 droppedRecords();
+
+private:
+    static bool append(Level level, const char* message, int valueCount,
+                       qint64 value1, qint64 value2, qint64 value3, qint64 value4);
+
+    // used by the logger's writer, with its logMutex held
+    static LoggerImpl* target();
+    static bool take(SignalSafeRecord* record);
+    // used by Logger::shutdown, so that nothing refers to the logger once it is destroyed
+    static void detach(LoggerImpl* logger);
+
+    friend class Logger;
+    friend class LoggerImpl;
+};
+
+}
+
+#endif // QSLOGSIGNALSAFE_H
@@ -0,0 +1,103 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include "QsLogStackTrace.h"
+#include <QFileInfo>
+#include <QtGlobal>
+#include <cstdlib>
+
+#if defined(__GLIBC__) || defined(Q_OS_MAC)
+#define QS_LOG_HAVE_BACKTRACE
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+
+namespace QsLogging
+{
+
+// deeper stacks are cut off
+static const int MaxFrames = 64;
+// the resolved frames kept at most, the cache is cleared when it grows past this
+static const int MaxCachedFrames = 4096;
+
+StackFrames StackTrace::capture(int skipFrames)
+{
+    StackFrames frames;
+#ifdef QS_LOG_HAVE_BACKTRACE
+    void* addresses[MaxFrames];
+    const int count = backtrace(addresses, MaxFrames);
+    for (int i = skipFrames + 1;i < count;++i)
+        frames.push_back(addresses[i]);
+#else
+    Q_UNUSED(skipFrames);
+#endif
+    return frames;
+}
+
+QString StackSymbolizer::resolve(const StackFrames& frames)
+{
+    if (mCache.size() > MaxCachedFrames)
+        mCache.clear();
+
+    QString text;
+    for (int i = 0;i < frames.size();++i) {
+        void* const address = frames.at(i);
+        if (!mCache.contains(address))
+            mCache.insert(address, resolveFrame(address));
+        text.append(QString::fromLatin1("\n  #%1 ").arg(i, 2)).append(mCache.value(address));
+    }
+    return text;
+}
+
+QString StackSymbolizer::resolveFrame(void* address)
+{
+    const QString raw = QString::fromLatin1("0x%1").arg(reinterpret_cast<quintptr>(address), 0, 16);
+#ifdef QS_LOG_HAVE_BACKTRACE
+    Dl_info info;
+    if (!dladdr(address, &info) || !info.dli_fname)
+        return raw;
+
+    const QString module = QFileInfo(QString::fromLocal8Bit(info.dli_fname)).fileName();
+    const char* base = static_cast<const char*>(info.dli_fbase);
+    if (!info.dli_sname || !info.dli_saddr) {
+        return QString::fromLatin1("%1+0x%2").arg(module)
+            .arg(static_cast<const char*>(address) - base, 0, 16);
+    }
+
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.dli_sname, 0, 0, &status);
+    const QString symbol = QString::fromLatin1(status == 0 && demangled ? demangled : info.dli_sname);
+    std::free(demangled);
+    return QString::fromLatin1("%1: %2+0x%3").arg(module, symbol)
+        .arg(static_cast<const char*>(address) - static_cast<const char*>(info.dli_saddr), 0, 16);
+#else
+    return raw;
+#endif
+}
+
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef QSLOGSTACKTRACE_H
+#define QSLOGSTACKTRACE_H
+
+#include "QsLogDest.h"
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace QsLogging
+{
+
+//! Raw return addresses, innermost first.
+typedef QVector<void*> StackFrames;
+
+class QSLOG_SHARED_OBJECT StackTrace
+{
+public:
+    //! Walks the calling thread's stack without resolving anything, which only takes
+    //! microseconds. 'skipFrames' leaves out the innermost callers, capture() itself is never
+    //! included. Returns no frames where unwinding isn't supported (only glibc and macOS are).
+    static StackFrames capture(int skipFrames = 0);
+};
+
+//! Resolves return addresses to "module: symbol+0xoffset" lines, or "module+0xoffset" for a
+//! function without an exported symbol, which addr2line can map to file:line. Addresses are
+//! cached, so a crash loop repeating the same stack is only resolved once. Not thread safe; the
+//! logger uses one on its writer thread.
+class QSLOG_SHARED_OBJECT StackSymbolizer
+{
+public:
+    //! One line per frame, each starting with a line break, to be appended to a message.
+    QString resolve(const StackFrames& frames);
+
+private:
+    QString resolveFrame(void* address);
+
+    QHash<void*, QString> mCache;
+};
+
+}
+
+#endif // QSLOGSTACKTRACE_H
@@ -68,6 +68,9 @@ int main(int argc, char *argv[])
    qDebug() << "This message won't be picked up by the logger";
    QLOG_ERROR() << "An error has occurred";
    qWarning() << "Neither will this one";
+   logger.installQtMessageHandler();
+   qWarning() << "But this one will, Qt's messages are now routed to the logger";
+   logger.removeQtMessageHandler();
    QLOG_FATAL() << "Fatal error!";
 
    logger.setLoggingLevel(QsLogging::OffLevel);
@@ -76,13 +79,17 @@ int main(int argc, char *argv[])
    }
    logger.setLoggingLevel(QsLogging::TraceLevel);
 
-   // 4. log from a shared library - should automatically share the same log instance as above
+   // 4. log from a shared library - binding it to our logger shares the same log instance as above
    QLibrary myLib("log_example_shared");
+   typedef void (*LogExampleBinder)(QsLogging::Logger*);
    typedef LogExampleShared* (*LogExampleGetter)();
    typedef void(*LogExampleDeleter)(LogExampleShared*);
+   LogExampleBinder fLogBinder = (LogExampleBinder) myLib.resolve("bindLogger");
    LogExampleGetter fLogCreator = (LogExampleGetter) myLib.resolve("createExample");
    LogExampleDeleter fLogDeleter = (LogExampleDeleter)myLib.resolve("destroyExample");
    LogExampleShared *logFromShared = 0;
+   if (fLogBinder)
+       fLogBinder(&logger);
    if (fLogCreator && fLogDeleter) {
        logFromShared = fLogCreator();
        logFromShared->logSomething();
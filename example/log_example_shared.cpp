@@ -31,6 +31,13 @@ void LogExampleShared::logSomething()
     QLOG_INFO() << "this message is comming from a shared library";
 }
 
+// Needed when QsLog is linked statically: without it this library would log to its own, unconfigured
+// logger. When QsLog is a shared library the host's logger is already the same one.
+void bindLogger(QsLogging::Logger *hostLogger)
+{
+    QsLogging::Logger::bindInstance(hostLogger);
+}
+
 LogExampleShared* createExample()
 {
     return new LogExampleShared();
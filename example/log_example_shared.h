@@ -28,6 +28,8 @@
 
 #include <QtGlobal>
 
+namespace QsLogging { class Logger; }
+
 #ifdef EXAMPLE_IS_SHARED_LIBRARY
 #define EXAMPLE_SHARED_OBJECT Q_DECL_IMPORT
 #else
@@ -41,6 +43,7 @@ public:
 };
 
 extern "C" {
+    void bindLogger(QsLogging::Logger *hostLogger);
     LogExampleShared *createExample();
     void destroyExample(LogExampleShared *example);
 }
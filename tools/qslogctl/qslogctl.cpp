@@ -0,0 +1,123 @@
+// Copyright (c) 2013, Razvan Petru
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice, this
+//   list of conditions and the following disclaimer in the documentation and/or other
+//   materials provided with the distribution.
+// * The name of the contributors may not be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include "QsLogSharedLevels.h"
+#include <QByteArray>
+#include <QSharedMemory>
+#include <QString>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace QsLogging;
+
+static const char* const LevelNames[] = { "trace", "debug", "info", "warn", "error", "fatal" };
+static const int LevelNameCount = sizeof(LevelNames) / sizeof(LevelNames[0]);
+
+static int Usage()
+{
+    std::fprintf(stderr,
+        "usage: qslogctl <key>                  shows the enabled levels\n"
+        "       qslogctl <key> level <name>     enables the levels from <name> up, e.g. debug\n"
+        "       qslogctl <key> enable <level>   enables one level, a name or a number (custom\n"
+        "       qslogctl <key> disable <level>  levels are %d to %d)\n"
+        "<key> is the one the process passed to Logger::shareLevels.\n",
+        FirstCustomLevel, LastCustomLevel);
+    return 2;
+}
+
+// a built-in name or a level number, -1 if it is neither
+static int ParseLevel(const char* text)
+{
+    for (int i = 0;i < LevelNameCount;++i) {
+        if (std::strcmp(text, LevelNames[i]) == 0)
+            return i;
+    }
+    char* end = 0;
+    const long number = std::strtol(text, &end, 10);
+    if (*text && !*end && number >= TraceLevel && number <= LastCustomLevel && number != OffLevel)
+        return static_cast<int>(number);
+    return -1;
+}
+
+static void Show(LevelMask levels)
+{
+    std::printf("levels 0x%08x:", levels);
+    for (int level = TraceLevel;level <= LastCustomLevel;++level) {
+        if (!(levels & levelBit(static_cast<Level>(level))))
+            continue;
+        if (level < LevelNameCount)
+            std::printf(" %s", LevelNames[level]);
+        else
+            std::printf(" %d", level);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 4)
+        return Usage();
+
+    QSharedMemory memory(QString::fromLocal8Bit(argv[1]));
+    if (!memory.attach() || memory.size() < static_cast<int>(sizeof(SharedLevelPage))) {
+        std::fprintf(stderr, "qslogctl: can't attach to %s: %s\n", argv[1],
+                     memory.errorString().toLocal8Bit().constData());
+        return 1;
+    }
+    SharedLevelPage* page = static_cast<SharedLevelPage*>(memory.data());
+    if (page->magic != SharedLevelPage::Magic || page->version != SharedLevelPage::Version) {
+        std::fprintf(stderr, "qslogctl: %s is not a QsLog level page\n", argv[1]);
+        return 1;
+    }
+    if (argc == 2) {
+        Show(page->levels.loadAcquire());
+        return 0;
+    }
+
+    const int level = ParseLevel(argv[3]);
+    if (level < 0)
+        return Usage();
+    const LevelMask bit = levelBit(static_cast<Level>(level));
+    if (std::strcmp(argv[2], "enable") == 0) {
+        page->levels.fetchAndOrOrdered(bit);
+    } else if (std::strcmp(argv[2], "disable") == 0) {
+        page->levels.fetchAndAndOrdered(~bit);
+    } else if (std::strcmp(argv[2], "level") == 0 && level < OffLevel) {
+        // the built-in levels from 'level' up; custom levels keep their state
+        const LevelMask builtIn = levelBit(OffLevel) - 1;
+        const LevelMask threshold = builtIn & ~(bit - 1);
+        LevelMask current;
+        do {
+            current = page->levels.loadAcquire();
+        } while (!page->levels.testAndSetOrdered(current, (current & ~builtIn) | threshold));
+    } else {
+        return Usage();
+    }
+    Show(page->levels.loadAcquire());
+    return 0;
+}
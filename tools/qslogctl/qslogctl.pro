@@ -0,0 +1,12 @@
+#This tool changes the levels of a process that called Logger::shareLevels. It only uses QsLog headers.
+
+QT -= gui
+TARGET = qslogctl
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+SOURCES += qslogctl.cpp
+INCLUDEPATH += $$PWD/../../
+
+DESTDIR = $$PWD/../../build-QsLogTools
+OBJECTS_DIR = $$DESTDIR/obj
@@ -1,9 +1,37 @@
 #include "QtTestUtil/QtTestUtil.h"
 #include "QsLog.h"
 #include "QsLogDest.h"
+#include "QsLogDestFile.h"
+#include "QsLogDestHistory.h"
+#include "QsLogDestRateLimit.h"
+#include "QsLogOutputCapture.h"
+#include "QsLogContext.h"
+#include "QsLogMetrics.h"
+#include "QsLogAdminSocket.h"
+#include "QsLogSharedLevels.h"
+#include "QsLogSignalSafe.h"
+#include <QCoreApplication>
+#include <QDate>
+#include <QDir>
+#include <QFile>
 #include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSharedMemory>
 #include <QSharedPointer>
+#include <QThreadPool>
 #include <QtGlobal>
+#include <cstdio>
+#include <limits>
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 // A destination that tracks log messages
 class MockDestination : public QsLogging::Destination
@@ -67,7 +95,100 @@ private:
     QList<Message> mMessages;
 };
 
+// Rotates when asked to, and has a number of backups that the file destination can delete when
+// the disk is full
+class ManualRotationStrategy : public QsLogging::RotationStrategy
+{
+public:
+    ManualRotationStrategy() : rotateNext(false), backups(0), removals(0) {}
+
+    void setInitialInfo(const QFile &) override {}
+    void includeMessageInCalculation(const QString &) override {}
+    bool shouldRotate() override { return rotateNext; }
+    void rotate() override { rotateNext = false; }
+    QString getFileName() override { return QString(); }
+    QIODevice::OpenMode recommendedOpenModeFlag() override { return QIODevice::Append; }
+    bool removeOldestBackup() override
+    {
+        ++removals;
+        if (!backups)
+            return false;
+        --backups;
+        return true;
+    }
+
+    bool rotateNext;
+    int backups;
+    int removals;
+};
+
+static void TouchFile(const QString &path)
+{
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+}
+
+static QString ReadFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    return QString::fromUtf8(file.readAll());
+}
+
+// A destination with a circuit breaker that the test trips by hand
+class BreakerDestination : public MockDestination
+{
+public:
+    virtual const QsLogging::DestinationHealth* health() const
+    {
+        return &breaker;
+    }
+
+    QsLogging::DestinationHealth breaker;
+};
+
 // Autotests for QsLog
+static void logFromDynamicSite()
+{
+    QLOG_DEBUG() << "dynamic debug";
+}
+
+static void logAtLevel(QsLogging::Level level)
+{
+    QLOG_AT(level) << "variable level";
+}
+
+static void logRequestTime(int ms)
+{
+    QLOG_DEBUG() << "request took" << ms << "ms";
+}
+
+static void logRequestDuration(int id, int ms)
+{
+    QLOG_MEASURE(QsLogging::DebugLevel, ms) << "request" << id << "took" << ms << "ms";
+}
+
+// call sites that are measured by hand, as if their statements ran
+static QsLogging::CallSite& locatedSite()
+{
+    return QS_LOG_CALL_SITE(QsLogging::InfoLevel);
+}
+
+static QsLogging::CallSite& hugeValueSite()
+{
+    return QS_LOG_CALL_SITE(QsLogging::InfoLevel);
+}
+
+class LoggingRunnable : public QRunnable
+{
+public:
+    void run() override
+    {
+        QLOG_INFO() << "from the pool";
+    }
+};
+
 class TestLog : public QObject
 {
     Q_OBJECT
@@ -84,6 +205,31 @@ private slots:
     void testMessageText();
     void testLevelChanges();
     void testLevelParsing();
+    void testRateLimit();
+    void testSeparateLoggers();
+    void testQtMessageHandler();
+    void testOutputCapture();
+    void testDiagnosticContext();
+    void testContextPropagation();
+    void testThreadLevelOverride();
+    void testCustomLevels();
+    void testCallSites();
+    void testTopTalkers();
+    void testLogDerivedMetrics();
+    void testStatisticsExport();
+    void testAdminCommands();
+    void testSharedLevels();
+    void testWriterWatchdog();
+    void testStackTrace();
+    void testSignalSafeLog();
+    void testBootBuffer();
+    void testTrimMemory();
+    void testDestinationHealth();
+    void testFullDisk();
+    void testRemoveOldestBackup();
+    void testBindInstance();
+    void testFork();
+    void testShutdown(); // keep last, the logger is unusable afterwards
     void cleanupTestCase();
 
 private:
@@ -193,6 +339,922 @@ void TestLog::testLevelParsing()
     }
 }
 
+void TestLog::testRateLimit()
+{
+    using namespace QsLogging;
+    QSharedPointer<MockDestination> mockDest(new MockDestination);
+    RateLimitedDestination limited(mockDest, 1000, ErrorLevel, 0);
+
+    // 300 characters + line terminator: three of them fit in the one second burst
+    const QString message(300, QLatin1Char('x'));
+    for (int i = 0;i < 5;++i)
+        limited.write(message, InfoLevel);
+    QCOMPARE(mockDest->messageCount(), 3);
+    QCOMPARE(limited.droppedMessages(), qint64(2));
+    QCOMPARE(limited.droppedBytes(), qint64(2 * 301));
+
+    // errors are never held back, even when the budget is exhausted
+    limited.write(message, ErrorLevel);
+    limited.write(message, FatalLevel);
+    QCOMPARE(mockDest->messageCountForLevel(ErrorLevel), 1);
+    QCOMPARE(mockDest->messageCountForLevel(FatalLevel), 1);
+    QCOMPARE(limited.droppedMessages(), qint64(2));
+
+    // the budget is in UTF-8 bytes: 250 two byte characters + line terminator don't fit in 500
+    RateLimitedDestination narrow(mockDest, 500, ErrorLevel, 0);
+    narrow.write(QString(250, QChar(0xe9)), InfoLevel);
+    QCOMPARE(narrow.droppedMessages(), qint64(1));
+    QCOMPARE(narrow.droppedBytes(), qint64(501));
+
+    // the logger reports the drops per destination, apart from its own
+    Logger logger;
+    logger.setIncludeTimestamp(false);
+    logger.setIncludeLogLevel(false);
+    logger.addDestination(mockDest);
+    logger.addDestination(DestinationFactory::MakeRateLimitedDestination(
+        mockDest, MaxBytesPerSecond(1000), ErrorLevel));
+    for (int i = 0;i < 5;++i)
+        logger.logText(InfoLevel, message);
+    const LoggerStatistics statistics = logger.statistics();
+    QCOMPARE(statistics.destinationDroppedMessages.size(), 2);
+    QCOMPARE(statistics.destinationDroppedMessages.at(0), qint64(0));
+    QCOMPARE(statistics.destinationDroppedMessages.at(1), qint64(2));
+    QCOMPARE(statistics.droppedRecords, qint64(0));
+    QVERIFY(OpenMetricsExport::text(statistics).contains(
+        QLatin1String("qslog_destination_dropped_messages_total{destination=\"1\"} 2\n")));
+}
+
+void TestLog::testSeparateLoggers()
+{
+    mockDest1->clear();
+    mockDest2->clear();
+
+    using namespace QsLogging;
+    QSharedPointer<MockDestination> tenantDest(new MockDestination);
+    {
+        Logger tenant;
+        tenant.addDestination(tenantDest);
+        tenant.setLoggingLevel(ErrorLevel);
+        Logger::instance().setLoggingLevel(TraceLevel);
+
+        QLOG_WARN_TO(tenant) << "below the tenant level";
+        QLOG_ERROR_TO(tenant) << "tenant error";
+        QLOG_DEBUG() << "global debug";
+        QCOMPARE(tenant.shutdown(-1), 0);
+    }
+
+    QCOMPARE(tenantDest->messageCount(), 1);
+    QVERIFY(tenantDest->hasMessage("tenant error", ErrorLevel));
+    QCOMPARE(mockDest1->messageCount(), 1);
+    QVERIFY(mockDest1->hasMessage("global debug", DebugLevel));
+    QCOMPARE(Logger::instance().effectiveLoggingLevel(), TraceLevel);
+}
+
+void TestLog::testQtMessageHandler()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    Logger::instance().setLoggingLevel(InfoLevel);
+    Logger::instance().installQtMessageHandler();
+    qDebug() << "qt debug";
+    qWarning() << "qt warning";
+    qCritical() << "qt critical";
+    Logger::instance().removeQtMessageHandler();
+    qWarning() << "after removal";
+    Logger::instance().setLoggingLevel(TraceLevel);
+
+    QCOMPARE(mockDest1->messageCount(), 2);
+    QVERIFY(mockDest1->hasMessage("qt warning", WarnLevel));
+    QVERIFY(mockDest1->hasMessage("qt critical", ErrorLevel));
+}
+
+void TestLog::testOutputCapture()
+{
+#if defined(Q_OS_UNIX)
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    OutputCaptureOptions options;
+    options.captureStdout = false;
+    options.stderrLevel = ErrorLevel;
+    options.stderrCategory = QLatin1String("native");
+    QVERIFY(StandardOutputCapture::start(Logger::instance(), options));
+    QVERIFY(!StandardOutputCapture::start(Logger::instance(), options));
+    fprintf(stderr, "first line\nsecond line\r\nunterminated");
+    fflush(stderr);
+    StandardOutputCapture::stop();
+    QVERIFY(!StandardOutputCapture::isActive());
+
+    QCOMPARE(mockDest1->messageCount(), 3);
+    QVERIFY(mockDest1->hasMessage("native: first line", ErrorLevel));
+    QVERIFY(mockDest1->hasMessage("native: second line", ErrorLevel));
+    QVERIFY(mockDest1->hasMessage("native: unterminated", ErrorLevel));
+    QVERIFY(!mockDest1->hasMessage("\r", ErrorLevel));
+
+    // a restart refreshes the copy of stderr, which stays close-on-exec
+    QVERIFY(StandardOutputCapture::start(Logger::instance(), options));
+    QVERIFY(::fcntl(StandardOutputCapture::originalStderr(), F_GETFD) & FD_CLOEXEC);
+
+    // a forked child writes to the original streams and has no capture to stop
+    const pid_t child = fork();
+    QVERIFY(child >= 0);
+    if (child == 0) {
+        const bool ended = !StandardOutputCapture::isActive()
+            && StandardOutputCapture::originalStderr() == STDERR_FILENO;
+        fprintf(stderr, "from the forked child\n");
+        fflush(stderr);
+        StandardOutputCapture::stop();
+        _exit(ended ? 0 : 1);
+    }
+    int status = 0;
+    QCOMPARE(waitpid(child, &status, 0), child);
+    QVERIFY(WIFEXITED(status));
+    QCOMPARE(WEXITSTATUS(status), 0);
+    StandardOutputCapture::stop();
+    QVERIFY(!mockDest1->hasMessage("from the forked child", ErrorLevel));
+#endif
+}
+
+void TestLog::testDiagnosticContext()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    {
+        ContextScope request(QLatin1String("request"), QLatin1String("42"));
+        QLOG_INFO() << "one pair";
+        {
+            ContextScope tenant(QLatin1String("tenant"), QLatin1String("acme"));
+            QLOG_INFO() << "two pairs";
+        }
+        QLOG_INFO() << "one pair again";
+    }
+    QLOG_INFO() << "no context";
+
+    QCOMPARE(mockDest1->messageCount(), 4);
+    QVERIFY(mockDest1->messageAt(0).text.contains("[request=42] one pair"));
+    QVERIFY(mockDest1->messageAt(1).text.contains("[request=42 tenant=acme] two pairs"));
+    QVERIFY(mockDest1->messageAt(2).text.contains("[request=42] one pair again"));
+    QVERIFY(!mockDest1->messageAt(3).text.contains('['));
+    QVERIFY(DiagnosticContext::rendered().isEmpty());
+}
+
+void TestLog::testContextPropagation()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    ContextSnapshot snapshot;
+    QThreadPool pool;
+    {
+        ContextScope request(QLatin1String("request"), QLatin1String("7"));
+        snapshot = ContextSnapshot::capture();
+        pool.start(new ContextRunnable(new LoggingRunnable));
+    }
+    pool.waitForDone();
+    {
+        InheritedContext inherited(snapshot);
+        QLOG_INFO() << "inherited";
+    }
+    QLOG_INFO() << "restored";
+
+    QCOMPARE(mockDest1->messageCount(), 3);
+    QVERIFY(mockDest1->messageAt(0).text.contains("[request=7] from the pool"));
+    QVERIFY(mockDest1->messageAt(1).text.contains("[request=7] inherited"));
+    QVERIFY(!mockDest1->messageAt(2).text.contains('['));
+}
+
+void TestLog::testThreadLevelOverride()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    Logger::instance().setLoggingLevel(InfoLevel);
+    ContextSnapshot snapshot;
+    {
+        ThreadLevelOverride traced(TraceLevel);
+        QLOG_DEBUG() << "traced debug";
+        {
+            ThreadLevelOverride silenced(ErrorLevel);
+            QLOG_WARN() << "silenced warning";
+        }
+        snapshot = ContextSnapshot::capture();
+    }
+    QLOG_DEBUG() << "untraced debug";
+    {
+        InheritedContext inherited(snapshot);
+        QLOG_TRACE() << "inherited trace";
+    }
+    QVERIFY(!ThreadLevelOverride::current(0));
+    Logger::instance().setLoggingLevel(TraceLevel);
+
+    QCOMPARE(mockDest1->messageCount(), 2);
+    QVERIFY(mockDest1->hasMessage("traced debug", DebugLevel));
+    QVERIFY(mockDest1->hasMessage("inherited trace", TraceLevel));
+}
+
+void TestLog::testCustomLevels()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    const Level audit = Logger::registerLevel(QLatin1String("AUDIT"));
+    QVERIFY(audit >= FirstCustomLevel && audit <= LastCustomLevel);
+    QCOMPARE(Logger::registerLevel(QLatin1String("AUDIT")), audit);
+    const Level perf = Logger::registerLevel(QLatin1String("PERF"));
+    QVERIFY(perf != audit);
+
+    QLOG_AT(audit) << "disabled by default";
+    Logger::instance().setLevelEnabled(audit, true);
+    Logger::instance().setLoggingLevel(OffLevel);
+    QLOG_AT(audit) << "audit record";
+    QLOG_FATAL() << "fatal while off";
+    QLOG_AT(perf) << "perf disabled";
+
+    Logger::instance().setEnabledLevels(levelBit(ErrorLevel) | levelBit(perf));
+    QCOMPARE(Logger::instance().loggingLevel(), ErrorLevel);
+    QLOG_WARN() << "warn not in set";
+    QLOG_ERROR() << "error in set";
+    QLOG_FATAL() << "fatal not in set";
+    QLOG_AT(perf) << "perf record";
+    QLOG_AT(audit) << "audit not in set";
+    Logger::instance().setEnabledLevels(0);
+    Logger::instance().setLoggingLevel(TraceLevel);
+
+    QCOMPARE(mockDest1->messageCount(), 3);
+    QVERIFY(mockDest1->hasMessage("audit record", audit));
+    QVERIFY(mockDest1->hasMessage("error in set", ErrorLevel));
+    QVERIFY(mockDest1->hasMessage("perf record", perf));
+    QVERIFY(mockDest1->messageAt(0).text.startsWith("AUDIT "));
+    QVERIFY(mockDest1->messageAt(2).text.startsWith("PERF  "));
+    QCOMPARE(Logger::levelFromLogMessage(mockDest1->messageAt(0).text), audit);
+}
+
+void TestLog::testCallSites()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    Logger::instance().setLoggingLevel(InfoLevel);
+    logFromDynamicSite();
+    QCOMPARE(mockDest1->messageCount(), 0);
+
+    QCOMPARE(CallSiteRegistry::setState(QLatin1String("*logFromDynamicSite*"), CallSite::Enabled), 1);
+    logFromDynamicSite();
+    QCOMPARE(mockDest1->messageCount(), 1);
+    QVERIFY(mockDest1->hasMessage("dynamic debug", DebugLevel));
+
+    const QList<CallSiteInfo> sites = CallSiteRegistry::sites(QLatin1String("*logFromDynamicSite*"));
+    QCOMPARE(sites.size(), 1);
+    QCOMPARE(sites.at(0).level, DebugLevel);
+    QCOMPARE(sites.at(0).levels, levelBit(DebugLevel));
+    QCOMPARE(sites.at(0).state, CallSite::Enabled);
+    QVERIFY(sites.at(0).file.endsWith(QLatin1String("TestLog.cpp")));
+
+    // rules also apply to statements that haven't run yet
+    CallSiteRegistry::setState(QLatin1String("*TestLog.cpp:*"), CallSite::Disabled);
+    QLOG_ERROR() << "disabled site";
+    QCOMPARE(mockDest1->messageCount(), 1);
+    CallSiteRegistry::setState(QLatin1String("*"), CallSite::FollowLevel);
+
+    // a statement with a variable level reports every level it ran at
+    logAtLevel(ErrorLevel);
+    logAtLevel(WarnLevel);
+    const QList<CallSiteInfo> variable = CallSiteRegistry::sites(QLatin1String("*logAtLevel*"));
+    QCOMPARE(variable.size(), 1);
+    QCOMPARE(variable.at(0).levels, levelBit(WarnLevel) | levelBit(ErrorLevel));
+    QCOMPARE(variable.at(0).level, WarnLevel);
+    QCOMPARE(variable.at(0).records, qint64(2));
+
+    Logger::instance().setLoggingLevel(TraceLevel);
+}
+
+void TestLog::testTopTalkers()
+{
+    using namespace QsLogging;
+    CallSiteRegistry::topTalkers(0); // starts a new window
+
+    for (int i = 0;i < 3;++i)
+        logFromDynamicSite();
+    QLOG_INFO() << "quiet";
+
+    const QList<CallSiteInfo> talkers = CallSiteRegistry::topTalkers(1, false);
+    QCOMPARE(talkers.size(), 1);
+    QCOMPARE(talkers.at(0).function.contains(QLatin1String("logFromDynamicSite")), true);
+    QCOMPARE(talkers.at(0).records, qint64(3));
+    QVERIFY(talkers.at(0).bytes > 3 * qint64(sizeof("dynamic debug")));
+    QVERIFY(CallSiteRegistry::topTalkersReport(5).contains(QLatin1String("logFromDynamicSite")));
+    QVERIFY(CallSiteRegistry::topTalkers(5).isEmpty());
+}
+
+void TestLog::testLogDerivedMetrics()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    QCOMPARE(CallSiteRegistry::setState(QLatin1String("*logFromDynamicSite*"), CallSite::Counted), 1);
+    CallSiteRegistry::setState(QLatin1String("*logRequestTime*"), CallSite::Measured);
+    logFromDynamicSite();
+    logFromDynamicSite();
+    logRequestTime(3);
+    logRequestTime(100);
+    QCOMPARE(mockDest1->messageCount(), 0);
+
+    const QList<CallSiteInfo> metrics = CallSiteRegistry::metrics();
+    QCOMPARE(metrics.size(), 2);
+    for (int i = 0;i < metrics.size();++i) {
+        const CallSiteInfo& metric = metrics.at(i);
+        if (metric.state == CallSite::Counted) {
+            QVERIFY(metric.buckets.isEmpty());
+            continue;
+        }
+        QCOMPARE(metric.records, qint64(2));
+        QCOMPARE(metric.sum, qint64(103));
+        QCOMPARE(metric.buckets.at(2), qint64(1)); // 3 <= 4
+        QCOMPARE(metric.buckets.at(7), qint64(1)); // 100 <= 128
+    }
+
+    // a named value is recorded, not the first number in the message
+    QCOMPARE(CallSiteRegistry::setState(QLatin1String("*logRequestDuration*"), CallSite::Measured), 0);
+    logRequestDuration(4711, 7);
+    QList<CallSiteInfo> named = CallSiteRegistry::sites(QLatin1String("*logRequestDuration*"));
+    QCOMPARE(named.size(), 1);
+    QCOMPARE(named.at(0).records, qint64(1));
+    QCOMPARE(named.at(0).sum, qint64(7));
+    QCOMPARE(mockDest1->messageCount(), 0);
+
+    // the file@line that QS_LOG_LINE_NUMBERS puts first isn't the value
+    CallSite& located = locatedSite();
+    located.measure(QString::fromLatin1("%1 @ %2 request took 5 ms")
+        .arg(QString::fromLocal8Bit(located.file)).arg(located.line));
+    QList<CallSiteInfo> sites = CallSiteRegistry::sites(QLatin1String("*locatedSite*"));
+    QCOMPARE(sites.size(), 1);
+    QCOMPARE(sites.at(0).sum, qint64(5));
+
+    // a value that doesn't fit is clamped instead of overflowing
+    hugeValueSite().measure(QLatin1String("took 123456789012345678901234567890 ms"));
+    sites = CallSiteRegistry::sites(QLatin1String("*hugeValueSite*"));
+    QCOMPARE(sites.size(), 1);
+    QCOMPARE(sites.at(0).sum, std::numeric_limits<qint64>::max());
+    QCOMPARE(sites.at(0).buckets.last(), qint64(1));
+
+    CallSiteRegistry::setState(QLatin1String("*"), CallSite::FollowLevel);
+}
+
+void TestLog::testStatisticsExport()
+{
+    using namespace QsLogging;
+    Logger& logger = Logger::instance();
+    const LoggerStatistics before = logger.statistics();
+    QCOMPARE(before.levelNames.at(WarnLevel), QString(QLatin1String("WARN")));
+    QCOMPARE(before.destinationBytes.size(), 2);
+
+    const QString path = QDir::tempPath() + QLatin1String("/qslog_test.prom");
+    QFile::remove(path);
+    MetricsExportOptions options;
+    options.filePath = path;
+    logger.setMetricsExport(options);
+    QLOG_WARN() << "counted";
+
+    const LoggerStatistics after = logger.statistics();
+    QCOMPARE(after.records.at(WarnLevel), before.records.at(WarnLevel) + 1);
+    QVERIFY(after.destinationBytes.at(0) > before.destinationBytes.at(0));
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QString text = QString::fromUtf8(file.readAll());
+    QVERIFY(text.contains(QLatin1String("qslog_records_total{level=\"WARN\"}")));
+    QVERIFY(text.contains(QLatin1String("qslog_write_latency_seconds_bucket{le=\"+Inf\"}")));
+    QVERIFY(text.endsWith(QLatin1String("# EOF\n")));
+    file.close();
+
+    logger.setMetricsExport(MetricsExportOptions());
+    QFile::remove(path);
+}
+
+void TestLog::testAdminCommands()
+{
+    using namespace QsLogging;
+    Logger& logger = Logger::instance();
+    AdminSocketOptions options;
+    options.history = QSharedPointer<HistoryDestination>(new HistoryDestination(2));
+    options.history->write(QLatin1String("first"), InfoLevel);
+    options.history->write(QLatin1String("second"), InfoLevel);
+    options.history->write(QLatin1String("third"), InfoLevel);
+
+    QCOMPARE(AdminSocket::execute(logger, options, QLatin1String("level warn")), QString(QLatin1String("ok\n")));
+    QCOMPARE(logger.loggingLevel(), WarnLevel);
+    QVERIFY(AdminSocket::execute(logger, options, QLatin1String("level loud")).startsWith(QLatin1String("error")));
+    QVERIFY(AdminSocket::execute(logger, options, QLatin1String("level tracex")).startsWith(QLatin1String("error")));
+    QVERIFY(AdminSocket::execute(logger, options, QLatin1String("level inf")).startsWith(QLatin1String("error")));
+    QCOMPARE(logger.loggingLevel(), WarnLevel);
+    QCOMPARE(AdminSocket::execute(logger, options, QLatin1String("level DEBUG")), QString(QLatin1String("ok\n")));
+    QCOMPARE(logger.loggingLevel(), DebugLevel);
+    QCOMPARE(AdminSocket::execute(logger, options, QLatin1String("history")),
+             QString(QLatin1String("second\nthird\nok\n")));
+    QVERIFY(AdminSocket::execute(logger, options, QLatin1String("stats")).contains(QLatin1String("# EOF")));
+    QCOMPARE(AdminSocket::execute(logger, options, QLatin1String("site *logFromDynamicSite* off")),
+             QString(QLatin1String("1 statements matched\nok\n")));
+    QVERIFY(AdminSocket::execute(logger, options, QLatin1String("bogus")).startsWith(QLatin1String("error")));
+
+#if defined(Q_OS_UNIX)
+    // only the owner can connect, from the moment the socket exists, and the umask is restored
+    const mode_t mask = ::umask(0);
+    ::umask(mask);
+    options.socketPath = QDir::temp().filePath(
+        QString::fromLatin1("qslog_admin_%1.sock").arg(QCoreApplication::applicationPid()));
+    QVERIFY(AdminSocket::start(logger, options));
+    struct stat info;
+    QCOMPARE(::stat(QFile::encodeName(options.socketPath).constData(), &info), 0);
+    QCOMPARE(info.st_mode & (S_IRWXG | S_IRWXO), mode_t(0));
+    QCOMPARE(::umask(mask), mask);
+
+    // a forked child doesn't own the server: stop() neither waits for its thread nor removes the
+    // parent's socket
+    const QByteArray path = QFile::encodeName(options.socketPath);
+    const pid_t child = fork();
+    QVERIFY(child >= 0);
+    if (child == 0) {
+        const bool active = AdminSocket::isActive();
+        AdminSocket::stop();
+        _exit(active ? 1 : 0);
+    }
+    int status = 0;
+    QCOMPARE(waitpid(child, &status, 0), child);
+    QVERIFY(WIFEXITED(status));
+    QCOMPARE(WEXITSTATUS(status), 0);
+    QCOMPARE(::stat(path.constData(), &info), 0);
+    AdminSocket::stop();
+
+    // a socket that another process listens on is left alone, a stale one is replaced
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.constData(), static_cast<size_t>(path.size()));
+    const int otherFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    QVERIFY(otherFd >= 0);
+    QCOMPARE(::bind(otherFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    QCOMPARE(::listen(otherFd, 1), 0);
+    QVERIFY(!AdminSocket::start(logger, options));
+    QCOMPARE(::stat(path.constData(), &info), 0);
+    ::close(otherFd);
+    QVERIFY(AdminSocket::start(logger, options));
+    AdminSocket::stop();
+#endif
+
+    CallSiteRegistry::setState(QLatin1String("*"), CallSite::FollowLevel);
+    logger.setLoggingLevel(TraceLevel);
+}
+
+void TestLog::testSharedLevels()
+{
+    using namespace QsLogging;
+    const QString key = QString::fromLatin1("qslog_test_%1").arg(QCoreApplication::applicationPid());
+    QSharedPointer<MockDestination> dest(new MockDestination);
+    Logger logger;
+    logger.addDestination(dest);
+    logger.setLoggingLevel(DebugLevel);
+    QVERIFY(logger.shareLevels(key));
+
+    // what qslogctl does
+    QSharedMemory external(key);
+    QVERIFY(external.attach());
+    SharedLevelPage* page = static_cast<SharedLevelPage*>(external.data());
+    QCOMPARE(page->levels.loadAcquire() & levelBit(DebugLevel), levelBit(DebugLevel));
+    page->levels.fetchAndAndOrdered(~levelBit(WarnLevel));
+
+    QLOG_WARN_TO(logger) << "switched off from outside";
+    QLOG_ERROR_TO(logger) << "still on";
+    QCOMPARE(dest->messageCount(), 1);
+
+    // the change outlives the logger recomputing its levels, e.g. for load shedding
+    page->levels.fetchAndOrOrdered(levelBit(TraceLevel));
+    LoadSheddingOptions shedding;
+    shedding.enabled = true;
+    logger.setLoadShedding(shedding);
+    logger.setLoadShedding(LoadSheddingOptions());
+    QCOMPARE(page->levels.loadAcquire() & levelBit(WarnLevel), LevelMask(0));
+    QCOMPARE(page->levels.loadAcquire() & levelBit(TraceLevel), levelBit(TraceLevel));
+    QCOMPARE(logger.enabledLevels() & levelBit(WarnLevel), LevelMask(0));
+    QCOMPARE(logger.loggingLevel(), TraceLevel);
+    QLOG_WARN_TO(logger) << "still off";
+    QCOMPARE(dest->messageCount(), 1);
+
+    logger.setLoggingLevel(WarnLevel);
+    QCOMPARE(page->levels.loadAcquire() & levelBit(WarnLevel), levelBit(WarnLevel));
+    external.detach();
+}
+
+void TestLog::testWriterWatchdog()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    Logger& logger = Logger::instance();
+    QSharedPointer<MockDestination> fallback(new MockDestination);
+    WriterWatchdogOptions options;
+    options.stallMs = 1;
+    options.fallback = fallback;
+    logger.setWriterWatchdog(options);
+    QCOMPARE(logger.writerWatchdog().stallMs, 1);
+
+    // a writer that keeps up is never reported
+    QLOG_INFO() << "quick write";
+    QCOMPARE(mockDest1->messageCount(), 1);
+    QCOMPARE(logger.statistics().stalledDestination, -1);
+    QCOMPARE(fallback->messageCount(), 0);
+
+    logger.setWriterWatchdog(WriterWatchdogOptions());
+}
+
+void TestLog::testStackTrace()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    Logger::instance().setStackTraceLevel(ErrorLevel);
+    QLOG_ERROR() << "with stack";
+    QLOG_WARN() << "without stack";
+    QCOMPARE(mockDest1->messageCount(), 2);
+    QVERIFY(!mockDest1->hasMessage(QLatin1String("#"), WarnLevel));
+
+    const StackFrames frames = StackTrace::capture();
+#if defined(__GLIBC__) || defined(Q_OS_MAC)
+    QVERIFY(!frames.isEmpty());
+    QVERIFY(mockDest1->hasMessage(QLatin1String("with stack\n  # 0 "), ErrorLevel));
+#endif
+    StackSymbolizer symbolizer;
+    QCOMPARE(symbolizer.resolve(frames), symbolizer.resolve(frames));
+
+    Logger::instance().setStackTraceLevel(FatalLevel);
+}
+
+void TestLog::testSignalSafeLog()
+{
+    mockDest1->clear();
+
+    using namespace QsLogging;
+    QVERIFY(!SignalSafeLog::write(ErrorLevel, "before initialize"));
+    QCOMPARE(SignalSafeLog::droppedRecords(), qint64(1));
+
+    QVERIFY(SignalSafeLog::initialize(Logger::instance(), 2));
+    QVERIFY(!SignalSafeLog::initialize(Logger::instance()));
+    QVERIFY(SignalSafeLog::write(WarnLevel, "child exited", 42, -1));
+    QVERIFY(SignalSafeLog::write(ErrorLevel, "terminating"));
+    QVERIFY(!SignalSafeLog::write(ErrorLevel, "buffer full"));
+    QCOMPARE(SignalSafeLog::droppedRecords(), qint64(2));
+    QCOMPARE(mockDest1->messageCount(), 0);
+
+    Logger::instance().flush();
+    QCOMPARE(mockDest1->messageCount(), 2);
+    QVERIFY(mockDest1->hasMessage(QLatin1String("child exited 42 -1"), WarnLevel));
+    QVERIFY(mockDest1->hasMessage(QLatin1String("terminating"), ErrorLevel));
+
+    // the slots are reused once the writer took the records
+    QVERIFY(SignalSafeLog::write(InfoLevel, "reused", 7));
+    QLOG_INFO() << "regular message";
+    QCOMPARE(mockDest1->messageCount(), 4);
+    QVERIFY(mockDest1->hasMessage(QLatin1String("reused 7"), InfoLevel));
+}
+
+void TestLog::testBootBuffer()
+{
+    using namespace QsLogging;
+    QSharedPointer<MockDestination> bootDest(new MockDestination);
+    {
+        Logger early;
+        BootBufferOptions options;
+        options.maxRecords = 2;
+        early.setBootBuffer(options);
+
+        QLOG_INFO_TO(early) << "first";
+        QLOG_WARN_TO(early) << "second";
+        QLOG_ERROR_TO(early) << "third";
+        early.flush();
+        QCOMPARE(bootDest->messageCount(), 0);
+        QVERIFY(early.memoryUsage().bootBytes > 0);
+
+        early.addDestination(bootDest);
+        QCOMPARE(early.memoryUsage().bootBytes, qint64(0));
+        QLOG_INFO_TO(early) << "after";
+        QCOMPARE(early.shutdown(-1), 0);
+    }
+
+    QCOMPARE(bootDest->messageCount(), 4);
+    QVERIFY(bootDest->messageAt(0).text.contains(QLatin1String("first")));
+    QVERIFY(bootDest->messageAt(1).text.contains(QLatin1String("second")));
+    QVERIFY(bootDest->hasMessage(QLatin1String("1 message logged before the first destination was added was dropped"), WarnLevel));
+    QVERIFY(bootDest->messageAt(3).text.contains(QLatin1String("after")));
+
+    // the records kept too long are discarded, even if nothing is logged after the timeout
+    QSharedPointer<MockDestination> lateDest(new MockDestination);
+    {
+        Logger late;
+        BootBufferOptions options;
+        options.timeoutMs = 50;
+        late.setBootBuffer(options);
+        QLOG_INFO_TO(late) << "too early";
+        QTest::qSleep(options.timeoutMs + 10);
+        late.addDestination(lateDest);
+        QLOG_INFO_TO(late) << "after";
+        QCOMPARE(late.shutdown(-1), 0);
+    }
+    QCOMPARE(lateDest->messageCount(), 1);
+    QVERIFY(lateDest->messageAt(0).text.contains(QLatin1String("after")));
+
+    // the kept records count against the memory budget, records at the keep level always fit
+    QSharedPointer<MockDestination> budgetDest(new MockDestination);
+    {
+        Logger tight;
+        tight.setMemoryBudget(MemoryBudget(1, ErrorLevel));
+        QLOG_INFO_TO(tight) << "over budget";
+        QLOG_ERROR_TO(tight) << "kept";
+        QCOMPARE(tight.memoryUsage().droppedRecords, qint64(1));
+        tight.addDestination(budgetDest);
+        QCOMPARE(tight.shutdown(-1), 0);
+    }
+    QCOMPARE(budgetDest->messageCount(), 2);
+    QVERIFY(budgetDest->hasMessage(QLatin1String("kept"), ErrorLevel));
+    QVERIFY(budgetDest->hasMessage(QLatin1String("1 message logged before the first destination was added was dropped"), WarnLevel));
+}
+
+void TestLog::testTrimMemory()
+{
+    using namespace QsLogging;
+    QSharedPointer<HistoryDestination> history(new HistoryDestination(2));
+    QString grown(QLatin1String("grown"));
+    grown.reserve(10000);
+    history->write(grown, InfoLevel);
+    QVERIFY(history->bufferedBytes() >= qint64(10000 * sizeof(QChar)));
+
+    Logger logger;
+    logger.addDestination(history);
+    QCOMPARE(logger.memoryUsage().destinationBytes, history->bufferedBytes());
+    logger.trimMemory();
+    QVERIFY(history->bufferedBytes() < qint64(1000));
+    QCOMPARE(logger.memoryUsage().destinationBytes, history->bufferedBytes());
+    QCOMPARE(history->messages(), QStringList() << QLatin1String("grown"));
+}
+
+void TestLog::testDestinationHealth()
+{
+    using namespace QsLogging;
+    DestinationHealth health;
+    QVERIFY(!health.recordFailure());
+    QVERIFY(!health.recordFailure());
+    QVERIFY(health.recordFailure());
+    QVERIFY(health.isTripped());
+    QCOMPARE(health.tripCount(), qint64(1));
+    QCOMPARE(health.retryDelayMs(), DestinationHealth::InitialRetryDelayMs);
+    QVERIFY(!health.shouldAttempt());
+    QCOMPARE(health.skippedCount(), qint64(1));
+
+    // the retry is allowed once the delay has passed, and a failed one backs off further
+    QTest::qSleep(DestinationHealth::InitialRetryDelayMs + 50);
+    QVERIFY(health.shouldAttempt());
+    QVERIFY(!health.recordFailure());
+    QCOMPARE(health.retryDelayMs(), 2 * DestinationHealth::InitialRetryDelayMs);
+    QVERIFY(!health.shouldAttempt());
+    for (int i = 0;i < 10;++i)
+        health.recordFailure();
+    QCOMPARE(health.retryDelayMs(), DestinationHealth::MaxRetryDelayMs);
+    QCOMPARE(health.tripCount(), qint64(1));
+    QCOMPARE(health.failureCount(), qint64(14));
+
+    QVERIFY(health.recordSuccess());
+    QVERIFY(!health.isTripped());
+    QCOMPARE(health.consecutiveFailures(), 0);
+    QCOMPARE(health.retryDelayMs(), DestinationHealth::InitialRetryDelayMs);
+    QVERIFY(health.shouldAttempt());
+
+    // the breaker state reaches the statistics and the export
+    QSharedPointer<BreakerDestination> dest(new BreakerDestination);
+    Logger logger;
+    logger.addDestination(dest);
+    for (int i = 0;i < DestinationHealth::TripThreshold;++i)
+        dest->breaker.recordFailure();
+    dest->breaker.shouldAttempt();
+    const LoggerStatistics statistics = logger.statistics();
+    QCOMPARE(statistics.destinationBreakerOpen.size(), 1);
+    QVERIFY(statistics.destinationBreakerOpen.at(0));
+    QCOMPARE(statistics.destinationBreakerTrips.at(0), qint64(1));
+    QCOMPARE(statistics.destinationSkippedRecords.at(0), qint64(1));
+    const QString text = OpenMetricsExport::text(statistics);
+    QVERIFY(text.contains(QLatin1String("qslog_destination_breaker_open{destination=\"0\"} 1\n")));
+    QVERIFY(text.contains(QLatin1String("qslog_destination_skipped_records_total{destination=\"0\"} 1\n")));
+}
+
+void TestLog::testFullDisk()
+{
+    using namespace QsLogging;
+    if (!QFile::exists(QLatin1String("/dev/full")))
+        QSKIP("needs /dev/full to simulate a full disk");
+
+    // the log file is a link to /dev/full until the disk "has room again"
+    const QString logPath = QDir::temp().filePath(
+        QString::fromLatin1("qslog_full_disk_%1.txt").arg(QCoreApplication::applicationPid()));
+    QFile::remove(logPath);
+    QVERIFY(QFile::link(QLatin1String("/dev/full"), logPath));
+    ManualRotationStrategy* strategy = new ManualRotationStrategy;
+    RotationStrategyPtr strategyPtr(strategy);
+    QSharedPointer<MockDestination> fallback(new MockDestination);
+    {
+        FileDestination file(logPath, strategyPtr, fallback);
+        strategy->backups = 2;
+        file.write(QLatin1String("lost"), InfoLevel);
+        // both backups were deleted, then there was nothing left to delete
+        QCOMPARE(strategy->removals, 3);
+        QCOMPARE(fallback->messageCount(), 2);
+        QVERIFY(fallback->hasMessage(QLatin1String("could not write to"), WarnLevel));
+        QVERIFY(fallback->hasMessage(QLatin1String("lost"), InfoLevel));
+        file.write(QLatin1String("also lost"), InfoLevel);
+        QCOMPARE(fallback->messageCount(), 3);
+
+        QVERIFY(QFile::remove(logPath));
+        strategy->rotateNext = true;
+        file.write(QLatin1String("written"), InfoLevel);
+        QCOMPARE(fallback->messageCount(), 4);
+        QVERIFY(fallback->hasMessage(QLatin1String("is writable again"), InfoLevel));
+        QCOMPARE(file.health()->consecutiveFailures(), 0);
+    }
+
+    QFile log(logPath);
+    QVERIFY(log.open(QIODevice::ReadOnly));
+    QCOMPARE(log.readAll(), QByteArray("written\n"));
+    log.close();
+    QFile::remove(logPath);
+}
+
+void TestLog::testRemoveOldestBackup()
+{
+    using namespace QsLogging;
+    QDir dir(QDir::temp().filePath(
+        QString::fromLatin1("qslog_backups_%1").arg(QCoreApplication::applicationPid())));
+    dir.removeRecursively();
+    QVERIFY(QDir().mkpath(dir.path()));
+
+    TouchFile(dir.filePath(QLatin1String("size.txt")));
+    TouchFile(dir.filePath(QLatin1String("size.txt.1")));
+    TouchFile(dir.filePath(QLatin1String("size.txt.2")));
+    SizeRotationStrategy size;
+    size.setInitialInfo(QFile(dir.filePath(QLatin1String("size.txt"))));
+    QVERIFY(size.removeOldestBackup());
+    QVERIFY(!QFile::exists(dir.filePath(QLatin1String("size.txt.2"))));
+    QVERIFY(QFile::exists(dir.filePath(QLatin1String("size.txt.1"))));
+    QVERIFY(size.removeOldestBackup());
+    QVERIFY(!size.removeOldestBackup());
+    QVERIFY(QFile::exists(dir.filePath(QLatin1String("size.txt"))));
+
+    // only the names calc_filename gives the daily logs are backups
+    DailyRotationStrategy daily;
+    daily.setInitialInfo(QFile(dir.filePath(QLatin1String("daily.txt"))));
+    TouchFile(daily.getFileName());
+    TouchFile(dir.filePath(QLatin1String("daily_2020_1_1.txt")));
+    TouchFile(dir.filePath(QLatin1String("daily_2020_1_2.txt")));
+    TouchFile(dir.filePath(QLatin1String("daily_notes.txt")));
+    TouchFile(dir.filePath(QLatin1String("daily_2020_1_x.txt")));
+    QVERIFY(daily.removeOldestBackup());
+    QVERIFY(daily.removeOldestBackup());
+    QVERIFY(!daily.removeOldestBackup());
+    QVERIFY(QFile::exists(daily.getFileName()));
+    QVERIFY(!QFile::exists(dir.filePath(QLatin1String("daily_2020_1_1.txt"))));
+    QVERIFY(!QFile::exists(dir.filePath(QLatin1String("daily_2020_1_2.txt"))));
+    QVERIFY(QFile::exists(dir.filePath(QLatin1String("daily_notes.txt"))));
+    QVERIFY(QFile::exists(dir.filePath(QLatin1String("daily_2020_1_x.txt"))));
+
+    dir.removeRecursively();
+}
+
+void TestLog::testBindInstance()
+{
+    using namespace QsLogging;
+    mockDest1->clear();
+    mockDest2->clear();
+    QSharedPointer<MockDestination> hostDest(new MockDestination);
+    {
+        Logger host;
+        host.setLoggingLevel(TraceLevel);
+        host.addDestination(hostDest);
+
+        // binding destroys the suite's own instance, it is set up again below
+        Logger::bindInstance(&host);
+        QCOMPARE(&Logger::instance(), &host);
+        QLOG_INFO() << "through the binding";
+        QCOMPARE(hostDest->messageCount(), 1);
+        QCOMPARE(mockDest1->messageCount(), 0);
+        Logger::bindInstance(&host);
+        QCOMPARE(&Logger::instance(), &host);
+
+        // the destroyed instance let go of the signal safe records, the host can take them over
+        QVERIFY(!SignalSafeLog::write(ErrorLevel, "nobody listens"));
+        QVERIFY(SignalSafeLog::initialize(host));
+        QVERIFY(SignalSafeLog::write(ErrorLevel, "to the host"));
+        host.flush();
+        QCOMPARE(hostDest->messageCount(), 2);
+        QVERIFY(hostDest->hasMessage(QLatin1String("to the host"), ErrorLevel));
+
+        // destroyInstance only removes the binding, the host keeps working
+        QCOMPARE(Logger::destroyInstance(), 0);
+        QLOG_INFO_TO(host) << "host still works";
+        QCOMPARE(hostDest->messageCount(), 3);
+        QVERIFY(&Logger::instance() != &host);
+        QLOG_INFO() << "module's own logger";
+        QCOMPARE(hostDest->messageCount(), 3);
+
+        // binding again destroys the logger instance() just created, 0 removes the binding
+        Logger::bindInstance(&host);
+        QCOMPARE(&Logger::instance(), &host);
+        Logger::bindInstance(0);
+        QLOG_INFO_TO(host) << "still works";
+        QCOMPARE(hostDest->messageCount(), 4);
+    }
+    QVERIFY(!SignalSafeLog::write(ErrorLevel, "host is gone"));
+
+    Logger::instance().setLoggingLevel(TraceLevel);
+    Logger::instance().addDestination(mockDest1);
+    Logger::instance().addDestination(mockDest2);
+    QLOG_INFO() << "suite's instance";
+    QCOMPARE(mockDest1->messageCount(), 1);
+    QCOMPARE(hostDest->messageCount(), 4);
+}
+
+void TestLog::testFork()
+{
+#if !defined(Q_OS_UNIX)
+    QSKIP("fork() is only available on Unix");
+#else
+    using namespace QsLogging;
+    QDir dir(QDir::temp().filePath(
+        QString::fromLatin1("qslog_fork_%1").arg(QCoreApplication::applicationPid())));
+    dir.removeRecursively();
+    QVERIFY(QDir().mkpath(dir.path()));
+
+    {
+        Logger logger;
+        logger.addDestination(DestinationFactory::MakeFileDestination(dir.filePath(QLatin1String("log.txt"))));
+        logger.addDestination(DestinationFactory::MakeDailyFileDestination(
+            dir.filePath(QLatin1String("daily.txt")), EnableLogRotation));
+        logger.setSeparateFilesAfterFork(true);
+        QLOG_INFO_TO(logger) << "parent before fork";
+
+        const pid_t child = fork();
+        QVERIFY(child >= 0);
+        if (child == 0) {
+            QLOG_INFO_TO(logger) << "child after fork";
+            logger.shutdown(-1);
+            _exit(0);
+        }
+        int status = 0;
+        QCOMPARE(waitpid(child, &status, 0), child);
+        QVERIFY(WIFEXITED(status));
+        QCOMPARE(WEXITSTATUS(status), 0);
+        QLOG_INFO_TO(logger) << "parent after fork";
+        logger.shutdown(-1);
+
+        // the child's files carry its pid in the base name, the daily log's date comes after it
+        const QDate today = QDate::currentDate();
+        const QString childLog = ReadFile(dir.filePath(QString::fromLatin1("log.%1.txt").arg(child)));
+        const QString childDaily = ReadFile(dir.filePath(QString::fromLatin1("daily.%1_%2_%3_%4.txt")
+            .arg(child).arg(today.year()).arg(today.month()).arg(today.day())));
+        const QString parentLog = ReadFile(dir.filePath(QLatin1String("log.txt")));
+        const QString parentDaily = ReadFile(dir.filePath(QString::fromLatin1("daily_%1_%2_%3.txt")
+            .arg(today.year()).arg(today.month()).arg(today.day())));
+        QVERIFY(childLog.contains(QLatin1String("child after fork")));
+        QVERIFY(!childLog.contains(QLatin1String("parent")));
+        QVERIFY(childDaily.contains(QLatin1String("child after fork")));
+        QVERIFY(!childDaily.contains(QLatin1String("parent")));
+        QVERIFY(parentLog.contains(QLatin1String("parent before fork")));
+        QVERIFY(parentLog.contains(QLatin1String("parent after fork")));
+        QVERIFY(!parentLog.contains(QLatin1String("child")));
+        QVERIFY(parentDaily.contains(QLatin1String("parent after fork")));
+        QVERIFY(!parentDaily.contains(QLatin1String("child")));
+    }
+    QCOMPARE(dir.entryList(QDir::Files).size(), 4);
+    dir.removeRecursively();
+#endif
+}
+
+void TestLog::testShutdown()
+{
+    mockDest1->clear();
+    mockDest2->clear();
+
+    using namespace QsLogging;
+    Logger::instance().setLoggingLevel(TraceLevel);
+    QCOMPARE(Logger::instance().shutdown(1000), 0);
+    QCOMPARE(Logger::instance().effectiveLoggingLevel(), OffLevel);
+
+    QLOG_FATAL() << "after shutdown";
+    QCOMPARE(mockDest1->messageCount(), 0);
+    QCOMPARE(mockDest2->messageCount(), 0);
+
+    // the level can't be lowered again once shut down
+    Logger::instance().setLoggingLevel(TraceLevel);
+    QCOMPARE(Logger::instance().effectiveLoggingLevel(), OffLevel);
+    QCOMPARE(Logger::instance().shutdown(1000), 0);
+}
+
 void TestLog::cleanupTestCase()
 {
     QsLogging::Logger::destroyInstance();
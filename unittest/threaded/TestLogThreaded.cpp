@@ -0,0 +1,247 @@
+// Tests that need the writer thread, i.e. QS_LOG_SEPARATE_THREAD. They run in a binary of their
+// own because the suite in ../TestLog.cpp expects messages to be written before the logging
+// call returns.
+
+#include "QtTestUtil/QtTestUtil.h"
+#include "QsLog.h"
+#include "QsLogDest.h"
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#ifndef QS_LOG_SEPARATE_THREAD
+#error "threaded.pro defines QS_LOG_SEPARATE_THREAD for these tests"
+#endif
+
+// A destination whose writes wait while it is closed, like a file on a hung disk. It can be
+// inspected by the test while the writer thread is blocked in it.
+class BlockingDestination : public QsLogging::Destination
+{
+public:
+    BlockingDestination() : mClosed(false) {}
+
+    virtual void write(const QString &message, QsLogging::Level level)
+    {
+        QMutexLocker lock(&mMutex);
+        if (mClosed)
+            mBlocked.release();
+        while (mClosed)
+            mOpened.wait(&mMutex);
+        mMessages.push_back(qMakePair(message, level));
+    }
+
+    virtual bool isValid()
+    {
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker lock(&mMutex);
+        mClosed = true;
+    }
+
+    void open()
+    {
+        QMutexLocker lock(&mMutex);
+        mClosed = false;
+        mOpened.wakeAll();
+    }
+
+    //! waits until a write is blocked in the closed destination
+    bool waitUntilBlocked(int timeoutMs)
+    {
+        return mBlocked.tryAcquire(1, timeoutMs);
+    }
+
+    int messageCount() const
+    {
+        QMutexLocker lock(&mMutex);
+        return mMessages.size();
+    }
+
+    bool hasMessage(const QString &messageContent, QsLogging::Level level) const
+    {
+        QMutexLocker lock(&mMutex);
+        for (int i = 0;i < mMessages.size();++i) {
+            if (mMessages.at(i).second == level && mMessages.at(i).first.contains(messageContent))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    mutable QMutex mMutex;
+    QWaitCondition mOpened;
+    QSemaphore mBlocked;
+    bool mClosed;
+    QList<QPair<QString, QsLogging::Level> > mMessages;
+};
+
+class TestLogThreaded : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testWriterStall();
+    void testLoadShedding();
+    void testMemoryBudget();
+    void testShutdownReleasesMemory();
+    void testStatisticsDuringStall();
+};
+
+void TestLogThreaded::testWriterStall()
+{
+    using namespace QsLogging;
+    // a writer stuck in the second destination
+    QSharedPointer<BlockingDestination> first(new BlockingDestination);
+    QSharedPointer<BlockingDestination> stuck(new BlockingDestination);
+    QSharedPointer<BlockingDestination> notices(new BlockingDestination);
+    Logger stalling;
+    stalling.addDestination(first);
+    stalling.addDestination(stuck);
+    WriterWatchdogOptions options;
+    options.stallMs = 50;
+    options.fallback = notices;
+    stalling.setWriterWatchdog(options);
+
+    stuck->close();
+    QLOG_INFO_TO(stalling) << "stuck";
+    QVERIFY(stuck->waitUntilBlocked(5000));
+    QTRY_COMPARE(stalling.statistics().stalledDestination, 1);
+    QCOMPARE(stalling.statistics().writerStalls, qint64(1));
+
+    // while it is stalled records below the keep level are dropped, errors still queue
+    QLOG_INFO_TO(stalling) << "dropped";
+    QLOG_ERROR_TO(stalling) << "kept";
+    QCOMPARE(stalling.statistics().droppedRecords, qint64(1));
+    QCOMPARE(notices->messageCount(), 0);
+
+    // once it makes progress the stall is reported to the fallback
+    stuck->open();
+    QTRY_COMPARE(notices->messageCount(), 1);
+    QVERIFY(notices->hasMessage(QLatin1String("stalled for"), WarnLevel));
+    QVERIFY(notices->hasMessage(QLatin1String("destination 1, 1 records below ERROR were dropped"), WarnLevel));
+    QCOMPARE(stalling.shutdown(-1), 0);
+    QCOMPARE(stuck->messageCount(), 2);
+    QVERIFY(stuck->hasMessage(QLatin1String("kept"), ErrorLevel));
+    QVERIFY(!stuck->hasMessage(QLatin1String("dropped"), InfoLevel));
+    QCOMPARE(stalling.statistics().stalledDestination, -1);
+    QCOMPARE(stalling.statistics().writerStalls, qint64(1));
+}
+
+void TestLogThreaded::testLoadShedding()
+{
+    using namespace QsLogging;
+    QSharedPointer<BlockingDestination> dest(new BlockingDestination);
+    Logger logger;
+    logger.addDestination(dest);
+    logger.setLoggingLevel(DebugLevel);
+    LoadSheddingOptions options;
+    options.enabled = true;
+    options.queueHighWater = 0;
+    options.lagHighWaterMs = 20;
+    options.lagLowWaterMs = 10;
+    options.maxLevel = InfoLevel;
+    options.idleRestoreMs = 50;
+    logger.setLoadShedding(options);
+
+    // the first record blocks the writer, the other two wait behind it
+    dest->close();
+    QLOG_DEBUG_TO(logger) << "first";
+    QVERIFY(dest->waitUntilBlocked(5000));
+    QLOG_DEBUG_TO(logger) << "second";
+    QLOG_DEBUG_TO(logger) << "third";
+    QTest::qSleep(50);
+    dest->open();
+
+    // "second" waited long enough to raise the level. "third" empties the queue, but it waited
+    // too long as well to restore it.
+    QTRY_COMPARE(dest->messageCount(), 4);
+    QVERIFY(dest->hasMessage(QLatin1String("load shedding raised the minimum level to INFO"), WarnLevel));
+    QCOMPARE(logger.effectiveLoggingLevel(), InfoLevel);
+    QLOG_DEBUG_TO(logger) << "shed";
+
+    // the first record after the queue stayed empty long enough restores the level
+    QTest::qSleep(100);
+    QLOG_INFO_TO(logger) << "after a pause";
+    QTRY_COMPARE(dest->messageCount(), 6);
+    QVERIFY(dest->hasMessage(QLatin1String("load shedding lowered the minimum level to DEBUG"), InfoLevel));
+    QVERIFY(!dest->hasMessage(QLatin1String("shed"), DebugLevel));
+    QCOMPARE(logger.effectiveLoggingLevel(), DebugLevel);
+    QCOMPARE(logger.shutdown(-1), 0);
+}
+
+void TestLogThreaded::testMemoryBudget()
+{
+    using namespace QsLogging;
+    QSharedPointer<BlockingDestination> dest(new BlockingDestination);
+    Logger logger;
+    logger.addDestination(dest);
+    // room for one of the records below, which take about 60 KB each
+    logger.setMemoryBudget(MemoryBudget(100000, ErrorLevel));
+    const QString large(30000, QLatin1Char('x'));
+
+    dest->close();
+    QLOG_INFO_TO(logger) << "fits" << large;
+    QVERIFY(dest->waitUntilBlocked(5000));
+    QLOG_INFO_TO(logger) << "over budget" << large;
+    QLOG_ERROR_TO(logger) << "kept" << large;
+    dest->open();
+
+    QTRY_COMPARE(dest->messageCount(), 2);
+    QVERIFY(dest->hasMessage(QLatin1String("fits"), InfoLevel));
+    QVERIFY(dest->hasMessage(QLatin1String("kept"), ErrorLevel));
+    QTRY_COMPARE(logger.memoryUsage().queuedBytes, qint64(0));
+    const MemoryUsage usage = logger.memoryUsage();
+    QCOMPARE(usage.budgetBytes, qint64(100000));
+    QCOMPARE(usage.droppedRecords, qint64(1));
+    QCOMPARE(logger.shutdown(-1), 0);
+}
+
+void TestLogThreaded::testShutdownReleasesMemory()
+{
+    using namespace QsLogging;
+    QSharedPointer<BlockingDestination> dest(new BlockingDestination);
+    Logger logger;
+    logger.addDestination(dest);
+
+    dest->close();
+    QLOG_INFO_TO(logger) << "first";
+    QVERIFY(dest->waitUntilBlocked(5000));
+    QLOG_INFO_TO(logger) << "discarded";
+    QLOG_INFO_TO(logger) << "discarded";
+    QLOG_INFO_TO(logger) << "discarded";
+    QCOMPARE(logger.shutdown(50), 3);
+    dest->open();
+
+    // the discarded records gave their memory back, the one being written does once it is done
+    QTRY_COMPARE(logger.memoryUsage().queuedBytes, qint64(0));
+    QCOMPARE(dest->messageCount(), 1);
+}
+
+void TestLogThreaded::testStatisticsDuringStall()
+{
+    using namespace QsLogging;
+    QSharedPointer<BlockingDestination> dest(new BlockingDestination);
+    Logger logger;
+    logger.addDestination(dest);
+    QLOG_INFO_TO(logger) << "written";
+    QTRY_COMPARE(logger.statistics().destinationBytes.at(0) > 0, true);
+
+    // the writer holds the log mutex while it is stuck, the counters are read without it
+    dest->close();
+    QLOG_INFO_TO(logger) << "stuck";
+    QVERIFY(dest->waitUntilBlocked(5000));
+    const LoggerStatistics statistics = logger.statistics();
+    QCOMPARE(statistics.destinationBytes.size(), 1);
+    QVERIFY(statistics.destinationBytes.at(0) > 0);
+    QCOMPARE(statistics.destinationRotations.size(), 1);
+    QCOMPARE(statistics.destinationDroppedMessages.size(), 1);
+    dest->open();
+}
+
+QTTESTUTIL_REGISTER_TEST(TestLogThreaded);
+#include "TestLogThreaded.moc"
@@ -0,0 +1,27 @@
+QT += core
+
+TARGET = QsLogThreadedUnitTest
+CONFIG += console qtestlib
+CONFIG -= app_bundle
+TEMPLATE = app
+
+# the tests that need the writer thread: load shedding, the memory budget and the watchdog. The
+# suite in ../unittest.pro expects synchronous writes and is built without it.
+DEFINES += QS_LOG_SEPARATE_THREAD
+
+# test-case sources
+SOURCES += TestLogThreaded.cpp
+
+# component sources
+include(../../QsLog.pri)
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    ../QtTestUtil/TestRegistry.cpp \
+    ../QtTestUtil/SimpleChecker.cpp
+
+HEADERS += \
+    ../QtTestUtil/TestRegistry.h \
+    ../QtTestUtil/TestRegistration.h \
+    ../QtTestUtil/QtTestUtil.h
@@ -8,6 +8,8 @@ TEMPLATE = app
 # test-case sources
 SOURCES += TestLog.cpp
 
+# the tests that need the writer thread are built by threaded/threaded.pro
+
 # component sources
 include(../QsLog.pri)
 